@@ -6,293 +6,3316 @@
 #include <sstream>
 #include <iomanip>
 #include <unordered_map>
+#include <unordered_set>
+#include <array>
 #include <algorithm>
 #include <chrono>
 #include <thread>
 #include <future>
 #include <mutex>
 #include <system_error>
+#include <atomic>
 #include <queue>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <csignal>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h> // FICLONE for reflink cloning
+#endif
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
 #include <openssl/evp.h>
 
+// io_uring support is optional: built in when liburing headers are present
+// (Linux scanner boxes), compiled out elsewhere (macOS).
+#if defined(__linux__) && __has_include(<liburing.h>)
+#include <liburing.h>
+#define FIND_DUPES_HAVE_URING 1
+#endif
+
 // Namespace alias for cleaner code
 namespace fs = std::filesystem;
 
+// ---------------------------------------------------------
+// Helper: Instrumentation (phase stats + live progress)
+// ---------------------------------------------------------
+// Counters and per-phase wall times for the whole scan. One scan per
+// process, so a single registry instance is enough. files/bytes counters
+// are bumped from the hashing workers; the phase table is filled by
+// recording Timer scopes in clean_up() and printed as a breakdown at the end,
+// so a long run shows where the time went (traversal vs hashing vs
+// aggregation) instead of one opaque total.
+struct ScanStats {
+    std::atomic<std::uint64_t> files_hashed{0};
+    std::atomic<std::uint64_t> bytes_hashed{0};
+
+    std::vector<std::pair<std::string, double>> phases;
+    std::mutex phases_mutex;
+
+    void record_phase(const std::string& name, double seconds) {
+        std::lock_guard<std::mutex> lock(phases_mutex);
+        phases.emplace_back(name, seconds);
+    }
+
+    void print_breakdown() {
+        std::lock_guard<std::mutex> lock(phases_mutex);
+        if (phases.empty()) return;
+        std::cout << "\nPhase breakdown:\n";
+        for (const auto& [name, seconds] : phases) {
+            std::cout << "  " << std::left << std::setw(24) << name
+                      << std::fixed << std::setprecision(3) << seconds << " s\n";
+        }
+        std::cout << std::defaultfloat;
+    }
+};
+
+ScanStats g_stats;
+
+// ---------------------------------------------------------
+// Helper: Thread Topology
+// ---------------------------------------------------------
+// Pool sizing and placement for every worker pool in the process (walkers,
+// hashing, verification, deletion). hardware_concurrency() alone is wrong
+// on dual-socket boxes (workers land on the socket far from the NIC doing
+// the NFS traffic) and on hybrid-core parts (hash work on E-cores halves
+// per-file latency), so --cpuset pins workers round-robin onto an explicit
+// CPU list and --threads overrides the count outright. Thread-local read
+// buffers are first touched by the pinned thread, which places them on that
+// thread's NUMA node without any allocator dependency.
+unsigned int g_thread_override = 0; // --threads; 0 = derive from cpuset/HW
+std::vector<int> g_cpuset;          // --cpuset; empty = no pinning
+
+unsigned int default_thread_count() {
+    if (g_thread_override) return g_thread_override;
+    if (!g_cpuset.empty()) return static_cast<unsigned int>(g_cpuset.size());
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 4; // Fallback
+}
+
+void pin_thread(unsigned int index) {
+#ifdef __linux__
+    if (g_cpuset.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(g_cpuset[index % g_cpuset.size()], &set);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+#else
+    (void)index;
+#endif
+}
+
+// Spawns count workers, pins each one onto the configured cpuset, runs
+// fn(thread_id) and joins. Every phase pool goes through here so placement
+// policy lives in one place.
+template <typename Fn>
+void run_worker_pool(unsigned int count, Fn&& fn) {
+    std::vector<std::thread> workers;
+    workers.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.emplace_back([&fn, i]() {
+            pin_thread(i);
+            fn(i);
+        });
+    }
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
 // ---------------------------------------------------------
 // Helper: Time execution (RAII style)
 // ---------------------------------------------------------
 class Timer {
     std::string name;
+    bool record; // also file the elapsed time into g_stats.phases
     std::chrono::high_resolution_clock::time_point start;
 public:
-    Timer(const std::string& func_name) : name(func_name), start(std::chrono::high_resolution_clock::now()) {}
+    Timer(const std::string& func_name, bool record_phase = false)
+        : name(func_name), record(record_phase), start(std::chrono::high_resolution_clock::now()) {}
     ~Timer() {
         auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> elapsed = end - start;
-        std::cout << "Function '" << name << "' executed in " << elapsed.count() << " seconds\n";
+        if (record) {
+            g_stats.record_phase(name, elapsed.count());
+        } else {
+            std::cout << "Function '" << name << "' executed in " << elapsed.count() << " seconds\n";
+        }
+    }
+};
+
+// Background thread that prints a throughput line every couple of seconds
+// while a pass runs: items/s, MB/s and (when the pass total is known) an
+// ETA. Quiet for passes that finish before the first tick, so small scans
+// stay as terse as before. Hashing passes read the global stat counters;
+// other phases (deletion) supply their own atomic counter and noun, in
+// which case the MB/s column is omitted.
+class ProgressReporter {
+    std::uint64_t total_files;
+    std::uint64_t base_files;
+    std::uint64_t base_bytes;
+    const std::atomic<std::uint64_t>* counter; // external count source, or null
+    const char* noun;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread reporter;
+
+    void run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                if (cv.wait_for(lock, std::chrono::seconds(2), [&] { return stopping; })) return;
+            }
+            std::uint64_t files = counter ? counter->load()
+                                          : g_stats.files_hashed.load() - base_files;
+            std::uint64_t bytes = g_stats.bytes_hashed.load() - base_bytes;
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed <= 0) continue;
+
+            double files_per_s = files / elapsed;
+            double mb_per_s = (bytes / (1024.0 * 1024.0)) / elapsed;
+            std::cout << "  progress: " << files << " " << noun
+                      << (total_files ? "/" + std::to_string(total_files) : "")
+                      << ", " << std::fixed << std::setprecision(0) << files_per_s
+                      << " " << noun << "/s";
+            if (!counter) {
+                std::cout << ", " << std::setprecision(1) << mb_per_s << " MB/s";
+            }
+            if (total_files && files_per_s > 0 && files < total_files) {
+                std::cout << ", ETA " << std::setprecision(0)
+                          << (total_files - files) / files_per_s << " s";
+            }
+            std::cout << std::defaultfloat << "\n" << std::flush;
+        }
+    }
+
+public:
+    // total_files == 0 means the pass total is unknown (streamed traversal)
+    explicit ProgressReporter(std::uint64_t total,
+                              const std::atomic<std::uint64_t>* count_source = nullptr,
+                              const char* what = "files")
+        : total_files(total),
+          base_files(g_stats.files_hashed.load()),
+          base_bytes(g_stats.bytes_hashed.load()),
+          counter(count_source),
+          noun(what),
+          start(std::chrono::steady_clock::now()),
+          reporter(&ProgressReporter::run, this) {}
+
+    ~ProgressReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_one();
+        if (reporter.joinable()) reporter.join();
     }
 };
 
 // ---------------------------------------------------------
-// Helper: Calculate MD5 Hash
+// Helper: Fast Hash (XXH64)
 // ---------------------------------------------------------
-std::string hash_file(const fs::path& path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) return ""; // Permission denied or file missing
+// The tool compares files for equality, it does not need a cryptographic
+// digest, so the hot path uses XXH64 (public-domain algorithm by Yann
+// Collet) which runs at memory bandwidth instead of MD5's ~500 MB/s/core.
+// MD5 is kept below as a confirmation pass on final collision groups so
+// the destructive path never trusts the fast hash alone.
+class XXH64State {
+    static constexpr std::uint64_t PRIME64_1 = 11400714785074694791ULL;
+    static constexpr std::uint64_t PRIME64_2 = 14029467366897019727ULL;
+    static constexpr std::uint64_t PRIME64_3 = 1609587929392839161ULL;
+    static constexpr std::uint64_t PRIME64_4 = 9650029242287828579ULL;
+    static constexpr std::uint64_t PRIME64_5 = 2870177450012600261ULL;
 
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    const EVP_MD* md = EVP_md5();
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int md_len;
+    std::uint64_t v1, v2, v3, v4;
+    std::uint64_t total_len = 0;
+    unsigned char buffer[32];
+    std::size_t buffered = 0;
+
+    static std::uint64_t rotl(std::uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
 
-    EVP_DigestInit_ex(mdctx, md, NULL);
+    static std::uint64_t read64(const unsigned char* p) {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v; // Little-endian assumed, same as every box we scan on
+    }
 
-    char buffer[8192];
-    while (file.read(buffer, sizeof(buffer))) {
-        EVP_DigestUpdate(mdctx, buffer, file.gcount());
+    static std::uint32_t read32(const unsigned char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
     }
-    EVP_DigestUpdate(mdctx, buffer, file.gcount()); // Handle remaining bytes
 
-    EVP_DigestFinal_ex(mdctx, hash, &md_len);
-    EVP_MD_CTX_free(mdctx);
+    static std::uint64_t round_(std::uint64_t acc, std::uint64_t input) {
+        acc += input * PRIME64_2;
+        acc = rotl(acc, 31);
+        acc *= PRIME64_1;
+        return acc;
+    }
 
-    std::stringstream ss;
-    for (unsigned int i = 0; i < md_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    void consume_stripe(const unsigned char* p) {
+        v1 = round_(v1, read64(p));
+        v2 = round_(v2, read64(p + 8));
+        v3 = round_(v3, read64(p + 16));
+        v4 = round_(v4, read64(p + 24));
     }
-    return ss.str();
-}
+
+public:
+    explicit XXH64State(std::uint64_t seed = 0)
+        : v1(seed + PRIME64_1 + PRIME64_2), v2(seed + PRIME64_2),
+          v3(seed), v4(seed - PRIME64_1) {}
+
+    void update(const void* data, std::size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        total_len += len;
+
+        if (buffered > 0) {
+            std::size_t fill = std::min(len, sizeof(buffer) - buffered);
+            std::memcpy(buffer + buffered, p, fill);
+            buffered += fill;
+            p += fill;
+            len -= fill;
+            if (buffered < sizeof(buffer)) return;
+            consume_stripe(buffer);
+            buffered = 0;
+        }
+
+        while (len >= sizeof(buffer)) {
+            consume_stripe(p);
+            p += sizeof(buffer);
+            len -= sizeof(buffer);
+        }
+
+        if (len > 0) {
+            std::memcpy(buffer, p, len);
+            buffered = len;
+        }
+    }
+
+    std::uint64_t digest() const {
+        std::uint64_t h;
+        if (total_len >= 32) {
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            for (std::uint64_t v : {v1, v2, v3, v4}) {
+                h ^= round_(0, v);
+                h = h * PRIME64_1 + PRIME64_4;
+            }
+        } else {
+            h = v3 + PRIME64_5; // v3 holds the seed for short inputs
+        }
+        h += total_len;
+
+        const unsigned char* p = buffer;
+        std::size_t len = buffered;
+        while (len >= 8) {
+            h ^= round_(0, read64(p));
+            h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+            p += 8;
+            len -= 8;
+        }
+        if (len >= 4) {
+            h ^= static_cast<std::uint64_t>(read32(p)) * PRIME64_1;
+            h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+            len -= 4;
+        }
+        while (len > 0) {
+            h ^= *p * PRIME64_5;
+            h = rotl(h, 11) * PRIME64_1;
+            ++p;
+            --len;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+};
 
 // ---------------------------------------------------------
-// Logic: Thread Pool for Parallel Hashing
+// Helper: Binary Digest
 // ---------------------------------------------------------
-struct FileResult {
-    fs::path path;
-    std::string hash;
+// Digests stay as raw bytes through the whole pipeline — FileResult, the
+// aggregation maps, the cache — and are only rendered as hex at display
+// time. At 10M files the old 32-char hex std::strings cost hundreds of MB
+// of allocations plus byte-wise string hashing in every unordered_map.
+// 16 bytes holds an MD5 digest; XXH64 values occupy the first 8 bytes and
+// leave the rest zero.
+struct Digest {
+    std::array<std::uint8_t, 16> bytes{};
+    bool ok = false; // false plays the role the "" sentinel used to
+
+    bool operator==(const Digest& other) const { return bytes == other.bytes; }
+
+    static Digest from64(std::uint64_t h) {
+        Digest d;
+        std::memcpy(d.bytes.data(), &h, sizeof(h));
+        d.ok = true;
+        return d;
+    }
+
+    std::string hex() const {
+        std::stringstream ss;
+        for (std::uint8_t b : bytes) {
+            ss << std::hex << std::setw(2) << std::setfill('0') << (int)b;
+        }
+        return ss.str();
+    }
 };
 
-std::vector<FileResult> process_files_parallel(const std::vector<fs::path>& files) {
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0) num_threads = 4; // Fallback
+// The digest is already uniformly distributed; the first 8 bytes are a
+// ready-made map key, no string hashing needed.
+struct DigestHasher {
+    std::size_t operator()(const Digest& d) const {
+        std::uint64_t v;
+        std::memcpy(&v, d.bytes.data(), sizeof(v));
+        return static_cast<std::size_t>(v);
+    }
+};
 
-    std::queue<fs::path> work_queue;
-    for (const auto& f : files) work_queue.push(f);
+using CollisionMap = std::unordered_map<Digest, std::vector<fs::path>, DigestHasher>;
 
-    std::mutex queue_mutex;
-    std::vector<FileResult> results;
-    std::mutex results_mutex;
-    std::vector<std::thread> workers;
+// ---------------------------------------------------------
+// Helper: Raw File I/O
+// ---------------------------------------------------------
+// Hashing reads go through open(2)/pread(2) with a 1MB per-thread buffer
+// instead of an 8KB-chunked std::ifstream: large requests keep NVMe queues
+// busy, and the thread_local buffer means zero stream construction and zero
+// allocation per file across millions of hash_file() calls.
+constexpr std::size_t READ_BUFFER_SIZE = 1 << 20;
 
-    auto worker = [&]() {
-        while (true) {
-            fs::path p;
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex);
-                if (work_queue.empty()) return;
-                p = work_queue.front();
-                work_queue.pop();
-            }
-            
-            // Hash without holding the lock (Parallel part)
-            std::string h = hash_file(p);
-            
-            if (!h.empty()) {
-                std::lock_guard<std::mutex> res_lock(results_mutex);
-                results.push_back({p, h});
+char* thread_read_buffer() {
+    thread_local std::vector<char> buffer(READ_BUFFER_SIZE);
+    return buffer.data();
+}
+
+// Files at or above this size are hashed straight out of a memory mapping
+// instead of being copied through the read buffer: the digest consumes the
+// page cache pages directly, halving memory traffic on the multi-GB files
+// that dominate total bytes.
+constexpr std::uintmax_t MMAP_HASH_THRESHOLD = 64 << 20; // 64MB
+
+// At and below this size per-file overhead (open/fstat/close and the read
+// syscalls themselves) dominates the hash cost, so the read path drops to
+// the bare minimum of syscalls: one exactly-sized pread.
+constexpr std::uintmax_t SMALL_FILE_THRESHOLD = 16 * 1024;
+
+// Read the whole file in READ_BUFFER_SIZE chunks, invoking
+// on_chunk(data, len) for each. Returns false if the file could not be
+// opened or read (same "skip quietly" semantics as the old ifstream path).
+// Large files are fed to on_chunk from an MADV_SEQUENTIAL mapping; small
+// files take a single-pread fast path; everything else streams through the
+// thread buffer.
+template <typename Fn>
+bool read_file_chunks(const fs::path& path, Fn&& on_chunk) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false; // Permission denied or file missing
+
+    struct stat st;
+    bool have_stat = fstat(fd, &st) == 0 && st.st_size >= 0;
+
+    // Small-file fast path: one pread sized by the fstat we already did —
+    // no readahead advice (the whole file is a single request) and no
+    // EOF-probing second read. Half a typical corpus is files this size,
+    // where the syscall count is what bounds files/second.
+    if (have_stat && static_cast<std::uintmax_t>(st.st_size) <= SMALL_FILE_THRESHOLD) {
+        char* buffer = thread_read_buffer();
+        std::size_t want = static_cast<std::size_t>(st.st_size);
+        std::size_t got = 0;
+        while (got < want) {
+            ssize_t n = ::pread(fd, buffer + got, want - got, got);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ::close(fd);
+                return false;
             }
+            if (n == 0) break; // Truncated between fstat and read
+            got += static_cast<std::size_t>(n);
         }
-    };
+        if (got > 0) {
+            on_chunk(buffer, got);
+            g_stats.bytes_hashed.fetch_add(got, std::memory_order_relaxed);
+        }
+        ::close(fd);
+        return true;
+    }
 
-    for (unsigned int i = 0; i < num_threads; ++i) {
-        workers.emplace_back(worker);
+    if (have_stat &&
+        static_cast<std::uintmax_t>(st.st_size) >= MMAP_HASH_THRESHOLD) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            // Feed the mapping in READ_BUFFER_SIZE slices so the digest's
+            // working set stays cache-sized even for very large files.
+            const char* data = static_cast<const char*>(map);
+            std::size_t remaining = st.st_size;
+            while (remaining > 0) {
+                std::size_t len = std::min(remaining, READ_BUFFER_SIZE);
+                on_chunk(data, len);
+                g_stats.bytes_hashed.fetch_add(len, std::memory_order_relaxed);
+                data += len;
+                remaining -= len;
+            }
+            munmap(map, st.st_size);
+            ::close(fd);
+            return true;
+        }
+        // mmap can fail (e.g. on some network filesystems); fall through
     }
 
-    for (auto& t : workers) {
-        if (t.joinable()) t.join();
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    char* buffer = thread_read_buffer();
+    off_t offset = 0;
+    while (true) {
+        ssize_t n = ::pread(fd, buffer, READ_BUFFER_SIZE, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            return false;
+        }
+        if (n == 0) break;
+        on_chunk(buffer, static_cast<std::size_t>(n));
+        g_stats.bytes_hashed.fetch_add(n, std::memory_order_relaxed);
+        offset += n;
     }
 
-    return results;
+    ::close(fd);
+    return true;
+}
+
+// Primary comparator: full-file XXH64.
+Digest hash_file(const fs::path& path) {
+    XXH64State state;
+    bool ok = read_file_chunks(path, [&](const char* data, std::size_t len) {
+        state.update(data, len);
+    });
+    if (!ok) return Digest{};
+    return Digest::from64(state.digest());
+}
+
+// Number of leading bytes hashed by the cheap pre-filter tier. 4KB is one
+// page / one read on most filesystems, and already separates nearly all
+// same-size non-duplicates without touching the rest of the file.
+constexpr std::size_t PREFIX_HASH_BYTES = 4096;
+
+// Cheap tier: hash only the first PREFIX_HASH_BYTES of the file. Two files
+// whose prefixes differ cannot be duplicates, so only prefix-collision
+// groups are escalated to the full-file hash_file() pass.
+Digest hash_file_prefix(const fs::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return Digest{}; // Permission denied or file missing
+
+    char buffer[PREFIX_HASH_BYTES];
+    ssize_t n = ::pread(fd, buffer, sizeof(buffer), 0);
+    ::close(fd);
+    if (n < 0) return Digest{};
+
+    XXH64State state;
+    state.update(buffer, static_cast<std::size_t>(n));
+    g_stats.bytes_hashed.fetch_add(n, std::memory_order_relaxed);
+    return Digest::from64(state.digest());
 }
 
 // ---------------------------------------------------------
-// Logic: Core Functionality
+// Helper: Cryptographic Hash (confirmation pass only)
+// ---------------------------------------------------------
+// MD5 by default; --digest switches the confirmation algorithm (compliance
+// scans want SHA-256, which OpenSSL runs on SHA-NI/AVX2 where available).
+// Digest keeps the leading 16 bytes of wider algorithms — ample for
+// equality grouping. The EVP context is cached per worker thread and reset
+// with EVP_DigestInit_ex between files: a fresh EVP_MD_CTX_new per file
+// was 10M allocations on a 10M-file confirmation pass.
+const EVP_MD* g_crypto_md = nullptr; // set by --digest; MD5 when null
+
+const EVP_MD* crypto_md() { return g_crypto_md ? g_crypto_md : EVP_md5(); }
+
+const char* crypto_md_name() { return OBJ_nid2sn(EVP_MD_type(crypto_md())); }
+
+Digest hash_file_crypto(const fs::path& path) {
+    struct MdCtxFree {
+        void operator()(EVP_MD_CTX* c) const { EVP_MD_CTX_free(c); }
+    };
+    static thread_local std::unique_ptr<EVP_MD_CTX, MdCtxFree> mdctx{EVP_MD_CTX_new()};
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int md_len;
+
+    EVP_DigestInit_ex(mdctx.get(), crypto_md(), NULL); // also resets the cached ctx
+
+    bool ok = read_file_chunks(path, [&](const char* data, std::size_t len) {
+        EVP_DigestUpdate(mdctx.get(), data, len);
+    });
+    if (!ok) return Digest{};
+
+    EVP_DigestFinal_ex(mdctx.get(), hash, &md_len);
+
+    Digest d;
+    std::memcpy(d.bytes.data(), hash, std::min<std::size_t>(md_len, d.bytes.size()));
+    d.ok = true;
+    return d;
+}
+
+// ---------------------------------------------------------
+// Logic: Persistent Hash Cache
 // ---------------------------------------------------------
+// On-disk cache of full-file hashes keyed by (path, size, mtime). Nightly
+// re-scans touch <1% of a typical tree, so reusing yesterday's digests for
+// files whose metadata is unchanged removes almost all of the hash I/O on
+// incremental runs. The format is a compact binary record stream:
+//   magic "FDHC", u32 version, u64 entry count,
+//   then per entry: u32 path_len, path bytes, u64 size, i64 mtime,
+//                   16 digest bytes.
+
+const char* const HASH_CACHE_FILE = ".find_dupes_cache";
+
+class HashCache {
+    struct Entry {
+        std::uintmax_t size;
+        std::int64_t mtime;
+        Digest hash;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    mutable std::mutex entries_mutex; // store() is called from hashing workers
 
+    static constexpr char MAGIC[4] = {'F', 'D', 'H', 'C'};
+    static constexpr std::uint32_t VERSION = 3; // v3: fixed 16-byte binary digests
 
-std::vector<fs::path> get_file_paths(const std::string& dir) {
-    std::vector<fs::path> file_paths;
-    
-    // Check if the directory exists first
-    std::error_code ec_dir_check;
-    if (!fs::exists(dir, ec_dir_check) || !fs::is_directory(dir, ec_dir_check)) {
-        std::cerr << "Error: Directory not found or inaccessible: " << dir << "\n";
-        return file_paths;
+public:
+    // File mtime in nanoseconds; only compared for equality, so the exact
+    // epoch does not matter as long as it is stable between runs.
+    static std::int64_t mtime_of(const struct stat& st) {
+        return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
     }
 
-    // Start the recursive iteration
-    // Use the error_code overload to prevent throwing an exception
-    // when a permission issue is encountered.
-    fs::recursive_directory_iterator it(dir, ec_dir_check);
-    
-    // Check for an initial error before looping
-    if (ec_dir_check) {
-        std::cerr << "Error initializing iterator for " << dir << ": " << ec_dir_check.message() << "\n";
-        return file_paths;
+    static std::int64_t mtime_of(const fs::path& path) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) return 0;
+        return mtime_of(st);
     }
-    
-    // Create a default iterator for the end condition
-    fs::recursive_directory_iterator end_it;
 
-    try {
-        for (; it != end_it; it.increment(ec_dir_check)) {
-            // If the increment caused an error (e.g., Permission denied)
-            if (ec_dir_check) {
-                std::cerr << "Skipping inaccessible directory: " << it->path().string() << " (" << ec_dir_check.message() << ")\n";
-                // Clear the error code and reset for the next increment
-                ec_dir_check.clear(); 
-                continue; 
-            }
+    void load(const std::string& cache_path) {
+        std::ifstream in(cache_path, std::ios::binary);
+        if (!in) return; // First run, or cache removed: start empty
+
+        char magic[4];
+        std::uint32_t version = 0;
+        std::uint64_t count = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+            std::cerr << "Ignoring unreadable or incompatible hash cache: " << cache_path << "\n";
+            return;
+        }
 
-            // Standard file processing logic
-            if (fs::is_regular_file(*it)) {
-                file_paths.push_back(fs::absolute(it->path()));
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::uint32_t path_len = 0;
+            std::uint64_t size = 0;
+            std::int64_t mtime = 0;
+            Digest hash;
+            in.read(reinterpret_cast<char*>(&path_len), sizeof(path_len));
+            std::string path(path_len, '\0');
+            in.read(path.data(), path_len);
+            in.read(reinterpret_cast<char*>(&size), sizeof(size));
+            in.read(reinterpret_cast<char*>(&mtime), sizeof(mtime));
+            in.read(reinterpret_cast<char*>(hash.bytes.data()), hash.bytes.size());
+            if (!in) {
+                std::cerr << "Truncated hash cache, keeping " << entries.size() << " entries\n";
+                return;
             }
+            hash.ok = true;
+            entries[std::move(path)] = {size, mtime, hash};
         }
-    } catch (const fs::filesystem_error& e) {
-        // This catch block is less likely to be hit with the error_code overload, 
-        // but it's kept for general safety.
-        std::cerr << "General Filesystem error during traversal: " << e.what() << "\n";
     }
-    
-    return file_paths;
+
+    // Written to a temp file and renamed into place, so a crash mid-save
+    // (the whole point of checkpointing) can never corrupt the cache.
+    void save(const std::string& cache_path) const {
+        std::string tmp_path = cache_path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Warning: could not write hash cache: " << tmp_path << "\n";
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(entries_mutex);
+
+        std::uint64_t count = entries.size();
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+        for (const auto& [path, entry] : entries) {
+            std::uint32_t path_len = static_cast<std::uint32_t>(path.size());
+            std::uint64_t size = entry.size;
+            out.write(reinterpret_cast<const char*>(&path_len), sizeof(path_len));
+            out.write(path.data(), path_len);
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(reinterpret_cast<const char*>(&entry.mtime), sizeof(entry.mtime));
+            out.write(reinterpret_cast<const char*>(entry.hash.bytes.data()), entry.hash.bytes.size());
+        }
+        out.close();
+
+        std::error_code ec;
+        fs::rename(tmp_path, cache_path, ec);
+        if (ec) {
+            std::cerr << "Warning: could not replace hash cache: " << ec.message() << "\n";
+        }
+    }
+
+    // Returns the cached digest, or one with ok == false on a miss (same
+    // convention as hash_file() for unreadable files).
+    Digest lookup(const fs::path& path, std::uintmax_t size, std::int64_t mtime) const {
+        std::lock_guard<std::mutex> lock(entries_mutex);
+        auto it = entries.find(path.string());
+        if (it == entries.end()) return Digest{};
+        if (it->second.size != size || it->second.mtime != mtime) return Digest{};
+        return it->second.hash;
+    }
+
+    void store(const fs::path& path, std::uintmax_t size, std::int64_t mtime, const Digest& hash) {
+        std::lock_guard<std::mutex> lock(entries_mutex);
+        entries[path.string()] = {size, mtime, hash};
+    }
+};
+
+// ---------------------------------------------------------
+// Logic: Thread Pool for Parallel Hashing
+// ---------------------------------------------------------
+struct FileResult {
+    fs::path path;
+    Digest hash;
+};
+
+// Which digest a parallel pass computes: the cheap 4KB prefix tier, the
+// full-file fast hash, or the cryptographic confirmation used before deletion.
+enum class HashMode { Prefix, Fast, Crypto };
+
+// Set by --uring: full-file passes use the asynchronous read engine below
+// instead of one synchronous read stream per thread.
+bool use_uring = false;
+
+// While the full-file pass runs, workers record finished digests here so a
+// killed scan resumes from its last checkpoint instead of from zero.
+HashCache* g_active_cache = nullptr;
+
+// Store a freshly computed full-file digest into the active cache, keyed by
+// the file's current metadata.
+void checkpoint_result(const fs::path& path, const Digest& hash) {
+    if (!g_active_cache || !hash.ok) return;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return;
+    g_active_cache->store(path, static_cast<std::uintmax_t>(st.st_size),
+                          HashCache::mtime_of(st), hash);
 }
 
-void display_collisions(const std::unordered_map<std::string, std::vector<fs::path>>& collisions) {
-    if (collisions.empty()) {
-        std::cout << "No hash collisions found.\n";
-        return;
+// How often in-flight progress is flushed to disk during the full-file pass.
+constexpr std::chrono::seconds CHECKPOINT_INTERVAL{300};
+
+// Background thread that saves the active cache at a fixed interval while a
+// long hashing pass runs, so a node reboot or OOM kill costs at most one
+// interval of work instead of the whole scan.
+class Checkpointer {
+    HashCache& cache;
+    std::string cache_path;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                if (cv.wait_for(lock, CHECKPOINT_INTERVAL, [&] { return stopping; })) return;
+            }
+            cache.save(cache_path);
+            std::cout << "  checkpoint: progress saved to " << cache_path << "\n" << std::flush;
+        }
     }
-    for (const auto& [hash, paths] : collisions) {
-        std::cout << "\nThe following files share the same hash (" << hash << "):\n";
-        for (size_t i = 0; i < paths.size(); ++i) {
-            std::cout << i + 1 << " - " << paths[i].string() << "\n";
+
+public:
+    Checkpointer(HashCache& c, std::string path)
+        : cache(c), cache_path(std::move(path)), worker(&Checkpointer::run, this) {}
+
+    ~Checkpointer() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
         }
+        cv.notify_one();
+        if (worker.joinable()) worker.join();
     }
-}
+};
 
-void delete_duplicates(std::unordered_map<std::string, std::vector<fs::path>>& collisions) {
-    for (auto& [hash, paths] : collisions) {
-        if (paths.size() > 1) {
-            // Sort by number of directory separators (depth), simplest/shortest path first
-            std::sort(paths.begin(), paths.end(), [](const fs::path& a, const fs::path& b) {
-                std::string sa = a.string();
-                std::string sb = b.string();
-                return std::count(sa.begin(), sa.end(), fs::path::preferred_separator) < 
-                       std::count(sb.begin(), sb.end(), fs::path::preferred_separator);
-            });
-
-            // Keep the first one (index 0), delete the rest
-            for (size_t i = 1; i < paths.size(); ++i) {
-                try {
-                    if (fs::remove(paths[i])) {
-                        std::cout << "Deleted: " << paths[i] << "\n";
-                    } else {
-                        std::cerr << "Failed to delete: " << paths[i] << "\n";
-                    }
-                } catch (const fs::filesystem_error& e) {
-                    std::cerr << "Error deleting " << paths[i] << ": " << e.what() << "\n";
+// ---------------------------------------------------------
+// Logic: Sharded Concurrent Aggregation
+// ---------------------------------------------------------
+// Building hash->paths on one thread after hashing was a serial reduce:
+// minutes of single-core map inserts at 20M results while the pool sat
+// idle. The map is sharded by the top digest bits into independent
+// lock-protected maps that hashing workers insert into directly as results
+// complete — no intermediate result vector — and finish() scans the shards
+// in parallel before merging the (small) surviving collision groups.
+constexpr std::size_t AGG_SHARD_COUNT = 64; // power of two
+
+class ShardedAggregator {
+    struct Shard {
+        CollisionMap map;
+        std::mutex mtx;
+    };
+    std::array<Shard, AGG_SHARD_COUNT> shards;
+
+    static std::size_t shard_of(const Digest& d) {
+        std::uint64_t top;
+        std::memcpy(&top, d.bytes.data(), sizeof(top));
+        return (top >> 58) & (AGG_SHARD_COUNT - 1); // top 6 bits
+    }
+
+public:
+    void insert(FileResult&& res) {
+        Shard& shard = shards[shard_of(res.hash)];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.map[res.hash].push_back(std::move(res.path));
+    }
+
+    // Drop singleton groups shard-by-shard in parallel, then merge what
+    // survives into one map. Only actual duplicates are left by then, so
+    // the serial merge touches a tiny fraction of the results.
+    CollisionMap finish() {
+        std::atomic<std::size_t> next_shard{0};
+        unsigned int num_threads =
+            std::min<unsigned int>(default_thread_count(), AGG_SHARD_COUNT);
+
+        run_worker_pool(num_threads, [&](unsigned int) {
+            while (true) {
+                std::size_t s = next_shard.fetch_add(1, std::memory_order_relaxed);
+                if (s >= AGG_SHARD_COUNT) break;
+                CollisionMap& map = shards[s].map;
+                for (auto it = map.begin(); it != map.end();) {
+                    if (it->second.size() < 2) it = map.erase(it);
+                    else ++it;
                 }
             }
+        });
+
+        CollisionMap collisions;
+        for (auto& shard : shards) {
+            for (auto& [hash, paths] : shard.map) {
+                collisions[hash] = std::move(paths);
+            }
+            shard.map.clear();
         }
+        return collisions;
     }
-}
+};
 
+#ifdef FIND_DUPES_HAVE_URING
 // ---------------------------------------------------------
-// Main Control
+// Logic: io_uring Read Engine
 // ---------------------------------------------------------
-void clean_up(const std::string& dir, bool show_collisions, bool delete_flag) {
-    Timer timer("clean_up"); // Helper class replicates the python decorator
+// One synchronous read per thread keeps at most num_threads requests in
+// flight, nowhere near enough to fill a deep NVMe queue. Each uring worker
+// instead keeps URING_QUEUE_DEPTH reads outstanding across that many files
+// at once, feeding completions into per-file digest states as data arrives,
+// so a handful of threads can saturate the array.
+constexpr unsigned URING_QUEUE_DEPTH = 32;
+constexpr std::size_t URING_READ_SIZE = 256 * 1024;
 
-    std::cout << "Gathering file paths...\n";
-    std::vector<fs::path> file_paths = get_file_paths(dir);
-    
-    std::cout << "Found " << file_paths.size() << " files. Hashing in parallel...\n";
-
-    // Run Parallel Hashing
-    std::vector<FileResult> results = process_files_parallel(file_paths);
+struct UringSlot {
+    fs::path path;
+    int fd = -1;
+    off_t offset = 0;
+    XXH64State state;
+    std::vector<char> buffer;
+};
 
-    // Aggregate results
-    std::unordered_map<std::string, std::vector<fs::path>> hash_to_files;
-    for (const auto& res : results) {
-        hash_to_files[res.hash].push_back(res.path);
+void uring_hash_worker(const std::vector<fs::path>& files,
+                       std::atomic<std::size_t>& next_index,
+                       std::vector<FileResult>& local,
+                       ShardedAggregator* aggregator) {
+    io_uring ring;
+    if (io_uring_queue_init(URING_QUEUE_DEPTH, &ring, 0) != 0) {
+        // Ring setup can fail (RLIMIT_MEMLOCK, old kernels): degrade to the
+        // synchronous path rather than dropping work.
+        while (true) {
+            std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+            if (i >= files.size()) return;
+            Digest h = hash_file(files[i]);
+            if (!h.ok) continue;
+            if (aggregator) aggregator->insert({files[i], h});
+            else local.push_back({files[i], h});
+        }
     }
 
-    // Filter collisions
-    std::unordered_map<std::string, std::vector<fs::path>> collisions;
-    for (const auto& entry : hash_to_files) {
-        if (entry.second.size() > 1) {
-            collisions[entry.first] = entry.second;
+    std::vector<UringSlot> slots(URING_QUEUE_DEPTH);
+    for (auto& slot : slots) slot.buffer.resize(URING_READ_SIZE);
+    unsigned in_flight = 0;
+
+    auto submit_read = [&](UringSlot& slot) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, slot.fd, slot.buffer.data(), URING_READ_SIZE, slot.offset);
+        io_uring_sqe_set_data(sqe, &slot);
+        ++in_flight;
+    };
+
+    // Claim the next file from the shared cursor into this slot and submit
+    // its first read. Returns false when the file list is exhausted.
+    auto start_next_file = [&](UringSlot& slot) {
+        while (true) {
+            std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+            if (i >= files.size()) return false;
+            int fd = ::open(files[i].c_str(), O_RDONLY);
+            if (fd < 0) continue; // Permission denied or file missing: skip
+            slot.path = files[i];
+            slot.fd = fd;
+            slot.offset = 0;
+            slot.state = XXH64State();
+            submit_read(slot);
+            return true;
         }
+    };
+
+    for (auto& slot : slots) {
+        if (!start_next_file(slot)) break;
     }
 
-    if (show_collisions) {
-        display_collisions(collisions);
-    } else {
-        std::cout << "Duplicates were found for " << collisions.size() << " individual files\n\n";
+    while (in_flight > 0) {
+        io_uring_submit_and_wait(&ring, 1);
+
+        io_uring_cqe* cqe;
+        while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+            UringSlot& slot = *static_cast<UringSlot*>(io_uring_cqe_get_data(cqe));
+            int res = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            --in_flight;
+
+            if (res > 0) {
+                slot.state.update(slot.buffer.data(), static_cast<std::size_t>(res));
+                g_stats.bytes_hashed.fetch_add(res, std::memory_order_relaxed);
+                slot.offset += res;
+                submit_read(slot);
+            } else {
+                // EOF (0) finishes the file; a read error skips it, matching
+                // read_file_chunks() semantics.
+                if (res == 0) {
+                    Digest h = Digest::from64(slot.state.digest());
+                    checkpoint_result(slot.path, h);
+                    if (aggregator) aggregator->insert({slot.path, h});
+                    else local.push_back({slot.path, h});
+                }
+                g_stats.files_hashed.fetch_add(1, std::memory_order_relaxed);
+                ::close(slot.fd);
+                slot.fd = -1;
+                start_next_file(slot);
+            }
+        }
     }
 
-    if (delete_flag) {
-        if (collisions.empty()) {
-            std::cout << "Nothing to delete. No duplicate files found\n";
+    io_uring_queue_exit(&ring);
+}
+#endif // FIND_DUPES_HAVE_URING
+
+// When an aggregator is supplied, workers insert completed results into it
+// directly and the returned vector stays empty; otherwise results are
+// collected per thread and merged as before.
+std::vector<FileResult> process_files_parallel(const std::vector<fs::path>& files, HashMode mode = HashMode::Fast,
+                                               unsigned int num_threads = 0, bool report_progress = true,
+                                               ShardedAggregator* aggregator = nullptr) {
+    if (num_threads == 0) num_threads = default_thread_count();
+
+    // Work distribution is a single atomic cursor over the pre-built files
+    // vector. Workers claim CURSOR_BATCH indices per fetch_add: on corpora
+    // that are mostly small files each hash finishes in microseconds and the
+    // cursor cache line itself becomes the contended resource, so batching
+    // cuts that traffic 16x. Worst-case tail imbalance is 15 files.
+    constexpr std::size_t CURSOR_BATCH = 16;
+    std::atomic<std::size_t> next_index{0};
+
+    // Each worker collects into a private vector; the per-file contention on
+    // a shared results mutex is replaced by one merge per thread at the end.
+    std::vector<std::vector<FileResult>> thread_results(num_threads);
+    // Per-device sub-pools share one reporter owned by the caller
+    std::unique_ptr<ProgressReporter> progress;
+    if (report_progress) progress = std::make_unique<ProgressReporter>(files.size());
+
+    auto worker = [&](unsigned int thread_id) {
+        std::vector<FileResult>& local = thread_results[thread_id];
+#ifdef FIND_DUPES_HAVE_URING
+        if (use_uring && mode == HashMode::Fast) {
+            uring_hash_worker(files, next_index, local, aggregator);
             return;
         }
+#endif
+        while (true) {
+            std::size_t begin = next_index.fetch_add(CURSOR_BATCH, std::memory_order_relaxed);
+            if (begin >= files.size()) return;
+            std::size_t end = std::min(begin + CURSOR_BATCH, files.size());
+            for (std::size_t i = begin; i < end; ++i) {
+                const fs::path& p = files[i];
 
-        std::cout << "Proceed to Delete? Hit Enter to Continue: ";
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Wait for enter
-        if (std::cin.peek() == '\n') std::cin.ignore(); 
-
-        std::cout << "\n\tWARNING: Deleting duplicate files can be dangerous!\n"
-                  << "\t- This tool will delete all duplicate instances.\n"
-                  << "\t- Only the single instance with the shortest path will be kept.\n\n";
+                Digest h;
+                switch (mode) {
+                    case HashMode::Prefix: h = hash_file_prefix(p); break;
+                    case HashMode::Fast:   h = hash_file(p); break;
+                    case HashMode::Crypto: h = hash_file_crypto(p); break;
+                }
 
-        if (!show_collisions) {
-            std::cout << "Do you want to see all the files which share the same binary data? (yes/no): ";
-            std::string resp;
-            std::cin >> resp;
-            if (resp == "yes" || resp == "y") {
-                display_collisions(collisions);
+                g_stats.files_hashed.fetch_add(1, std::memory_order_relaxed);
+                if (h.ok) {
+                    if (mode == HashMode::Fast) checkpoint_result(p, h);
+                    if (aggregator) aggregator->insert({p, h});
+                    else local.push_back({p, h});
+                }
             }
         }
+    };
 
-        std::cout << "Do you know what you are doing (yes/no)? ";
-        std::string confirm;
-        std::cin >> confirm;
+    run_worker_pool(num_threads, worker);
 
-        if (confirm == "yes" || confirm == "y") {
-            delete_duplicates(collisions);
-        } else {
-            std::cout << "Aborted deletion.\n";
+    std::vector<FileResult> results;
+    if (!aggregator) {
+        results.reserve(files.size());
+        for (auto& local : thread_results) {
+            for (auto& res : local) results.push_back(std::move(res));
         }
     }
+
+    return results;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <directory> [--show-duplicates] [--delete]\n";
-        return 1;
-    }
+// ---------------------------------------------------------
+// Logic: Core Functionality
+// ---------------------------------------------------------
 
-    std::string directory = argv[1];
-    bool show_duplicates = false;
+
+// ---------------------------------------------------------
+// Logic: Path Interning
+// ---------------------------------------------------------
+// Deep trees repeat the same long directory prefix across thousands of
+// files, and holding every file as a full fs::path made traversal output
+// the largest allocation in the process. Directories are interned once into
+// a shared arena and each file carries only a 4-byte parent id plus its
+// leaf name; the full path is materialized on demand for the (far fewer)
+// files that survive the size pre-filter.
+class PathArena {
+    std::vector<std::string> entries;
+    std::unordered_map<std::string, std::uint32_t> ids;
+    mutable std::mutex mtx; // walker threads intern concurrently
+
+public:
+    std::uint32_t intern(const fs::path& dir) {
+        std::string key = dir.string();
+        std::lock_guard<std::mutex> lock(mtx);
+        auto [it, inserted] = ids.try_emplace(std::move(key),
+                                              static_cast<std::uint32_t>(entries.size()));
+        if (inserted) entries.push_back(it->first);
+        return it->second;
+    }
+
+    fs::path resolve(std::uint32_t id, const std::string& leaf) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return fs::path(entries[id]) / leaf;
+    }
+};
+
+PathArena g_paths;
+
+// ---------------------------------------------------------
+// Logic: Traversal Filters
+// ---------------------------------------------------------
+// --min-size/--max-size/--exclude/--ext are evaluated inside the walker,
+// before a path is ever materialized into an entry. Excluded directory names
+// also prune the whole subtree from recursion (the walker simply never
+// enqueues them), so a `.git` or `node_modules` exclusion removes those
+// trees from the stat storm entirely, not just from the results.
+struct ScanFilter {
+    std::uintmax_t min_size = 0;
+    std::uintmax_t max_size = std::numeric_limits<std::uintmax_t>::max();
+    std::vector<std::string> exclude_globs; // fnmatch patterns against leaf names
+    std::vector<std::string> extensions;    // with leading dot; empty = all
+
+    bool excluded(const std::string& leaf) const {
+        for (const auto& glob : exclude_globs) {
+            if (::fnmatch(glob.c_str(), leaf.c_str(), 0) == 0) return true;
+        }
+        return false;
+    }
+
+    // Directories only face the exclude globs; size and extension are
+    // file-level concepts.
+    bool allows_dir(const std::string& leaf) const { return !excluded(leaf); }
+
+    bool allows_file(const std::string& leaf, std::uintmax_t size) const {
+        if (size < min_size || size > max_size) return false;
+        if (excluded(leaf)) return false;
+        if (!extensions.empty()) {
+            auto dot = leaf.rfind('.');
+            std::string ext = dot == std::string::npos ? "" : leaf.substr(dot);
+            bool found = false;
+            for (const auto& e : extensions) {
+                if (ext == e) { found = true; break; }
+            }
+            if (!found) return false;
+        }
+        return true;
+    }
+};
+
+ScanFilter g_filter;
+
+// A file discovered during traversal, together with its size and stat
+// identity. Everything is captured from one stat() in the walker so later
+// stages never need a second metadata round-trip. (dev, ino) identifies the
+// underlying inode: paths sharing it are hardlinks to the same bytes. The
+// path is stored interned (parent id + leaf); use full_path() to rebuild it.
+struct FileEntry {
+    std::uint32_t dir_id = 0;
+    std::string leaf;
+    std::uintmax_t size = 0;
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::uint64_t nlink = 1;
+
+    fs::path full_path() const { return g_paths.resolve(dir_id, leaf); }
+};
+
+// Paths that were recognized as hardlinks of a representative (keyed by the
+// representative's path string) and therefore excluded from hashing.
+using HardlinkMap = std::unordered_map<std::string, std::vector<fs::path>>;
+
+// Inode identity used to detect hardlinks across the scan.
+struct DevIno {
+    std::uint64_t dev;
+    std::uint64_t ino;
+    bool operator==(const DevIno& other) const {
+        return dev == other.dev && ino == other.ino;
+    }
+};
+
+struct DevInoHasher {
+    std::size_t operator()(const DevIno& k) const {
+        return std::hash<std::uint64_t>{}(k.ino ^ (k.dev * 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+// Walk the tree rooted at dir and invoke on_file(FileEntry&&) for every
+// regular file. Shared by the phased get_file_paths() collector and the
+// streamed producer in clean_up(), so the error-skip behavior stays in one
+// place.
+//
+// The walk is parallel: a pool of walker threads shares a stack of pending
+// directories, each thread claims one directory at a time, lists it with a
+// non-recursive directory_iterator, pushes subdirectories back for other
+// walkers to steal, and emits files. This turns the serial stat storm of
+// recursive_directory_iterator into a fan-out bounded only by the metadata
+// server. on_file may be invoked from multiple threads concurrently.
+template <typename Fn>
+void traverse_directory(const std::vector<std::string>& dirs, Fn&& on_file) {
+    std::vector<fs::path> pending;
+    for (const auto& dir : dirs) {
+        // Check if the directory exists first
+        std::error_code ec_dir_check;
+        if (!fs::exists(dir, ec_dir_check) || !fs::is_directory(dir, ec_dir_check)) {
+            std::cerr << "Error: Directory not found or inaccessible: " << dir << "\n";
+            continue;
+        }
+        pending.push_back(fs::absolute(dir));
+    }
+    if (pending.empty()) return;
+
+    unsigned int num_threads = default_thread_count();
+
+    std::size_t active_walkers = 0;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+
+    auto walker = [&]() {
+        while (true) {
+            fs::path current;
+            {
+                std::unique_lock<std::mutex> lock(pending_mutex);
+                pending_cv.wait(lock, [&] { return !pending.empty() || active_walkers == 0; });
+                if (pending.empty()) return; // No work and nobody producing more
+                current = std::move(pending.back());
+                pending.pop_back();
+                ++active_walkers;
+            }
+
+            // List one directory. The error_code overloads keep permission
+            // problems as per-entry skips instead of thrown exceptions.
+            std::error_code ec;
+            fs::directory_iterator it(current, ec);
+            if (ec) {
+                std::cerr << "Skipping inaccessible directory: " << current.string() << " (" << ec.message() << ")\n";
+            } else {
+                // One arena entry per listed directory, shared by every file
+                // emitted from it.
+                const std::uint32_t dir_id = g_paths.intern(current);
+                std::vector<fs::path> subdirs;
+                fs::directory_iterator end_it;
+                for (; it != end_it; it.increment(ec)) {
+                    if (ec) {
+                        std::cerr << "Skipping inaccessible directory: " << current.string() << " (" << ec.message() << ")\n";
+                        break;
+                    }
+
+                    std::error_code ec_type;
+                    if (it->is_directory(ec_type) && !it->is_symlink(ec_type)) {
+                        // Pruned subtrees are simply never enqueued, the
+                        // walker's equivalent of disable_recursion_pending().
+                        if (g_filter.allows_dir(it->path().filename().string())) {
+                            subdirs.push_back(it->path());
+                        }
+                    } else if (it->is_regular_file(ec_type)) {
+                        // One stat() gives size plus the (dev, inode, nlink)
+                        // identity used for hardlink detection downstream.
+                        struct stat st;
+                        if (::stat(it->path().c_str(), &st) != 0) {
+                            std::cerr << "Skipping unreadable file: " << it->path().string() << " (" << std::strerror(errno) << ")\n";
+                            continue;
+                        }
+                        std::string leaf = it->path().filename().string();
+                        if (!g_filter.allows_file(leaf, static_cast<std::uintmax_t>(st.st_size))) {
+                            continue;
+                        }
+                        on_file(FileEntry{dir_id,
+                                          std::move(leaf),
+                                          static_cast<std::uintmax_t>(st.st_size),
+                                          static_cast<std::uint64_t>(st.st_dev),
+                                          static_cast<std::uint64_t>(st.st_ino),
+                                          static_cast<std::uint64_t>(st.st_nlink)});
+                    }
+                }
+
+                if (!subdirs.empty()) {
+                    std::lock_guard<std::mutex> lock(pending_mutex);
+                    for (auto& d : subdirs) pending.push_back(std::move(d));
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex);
+                --active_walkers;
+            }
+            // Wake peers: either new subdirectories arrived, or this was the
+            // last active walker and everyone should re-check for shutdown.
+            pending_cv.notify_all();
+        }
+    };
+
+    run_worker_pool(num_threads, [&](unsigned int) { walker(); });
+}
+
+std::vector<FileEntry> get_file_paths(const std::vector<std::string>& dirs) {
+    std::vector<FileEntry> file_paths;
+    std::mutex collect_mutex; // on_file is called from multiple walker threads
+    traverse_directory(dirs, [&](FileEntry&& entry) {
+        std::lock_guard<std::mutex> lock(collect_mutex);
+        file_paths.push_back(std::move(entry));
+    });
+    return file_paths;
+}
+
+// ---------------------------------------------------------
+// Logic: Per-Device Worker Pools
+// ---------------------------------------------------------
+// Different backing stores want very different parallelism: an NFS filer
+// degrades under dozens of concurrent readers while local NVMe wants all of
+// them. Files are grouped by st_dev and each device gets its own pool,
+// running concurrently so a slow filer never idles the fast disks.
+unsigned int device_thread_count(const fs::path& sample) {
+#ifdef __linux__
+    struct statfs sfs;
+    if (statfs(sample.c_str(), &sfs) == 0) {
+        switch (static_cast<unsigned int>(sfs.f_type)) {
+            case 0x6969:     // NFS
+            case 0xFF534D42: // CIFS
+            case 0xFE534D42: // SMB2
+            case 0x517B:     // SMB
+                return 4;    // Network mounts: few deep readers
+        }
+    }
+#endif
+    return default_thread_count();
+}
+
+std::vector<FileResult> process_files_per_device(
+        std::unordered_map<std::uint64_t, std::vector<fs::path>>& device_groups,
+        HashMode mode = HashMode::Fast,
+        ShardedAggregator* aggregator = nullptr) {
+    if (device_groups.size() == 1) {
+        return process_files_parallel(device_groups.begin()->second, mode,
+                                      /*num_threads=*/0, /*report_progress=*/true, aggregator);
+    }
+
+    std::size_t total = 0;
+    for (const auto& [dev, paths] : device_groups) total += paths.size();
+    ProgressReporter progress(total);
+
+    std::vector<FileResult> results;
+    results.reserve(total);
+    std::mutex results_mutex;
+
+    std::vector<std::thread> pools;
+    for (auto& [dev, paths] : device_groups) {
+        pools.emplace_back([&, &paths = paths]() {
+            unsigned int threads = device_thread_count(paths.front());
+            std::vector<FileResult> local =
+                process_files_parallel(paths, mode, threads, /*report_progress=*/false, aggregator);
+            if (local.empty()) return;
+            std::lock_guard<std::mutex> lock(results_mutex);
+            for (auto& res : local) results.push_back(std::move(res));
+        });
+    }
+    for (auto& t : pools) {
+        if (t.joinable()) t.join();
+    }
+
+    return results;
+}
+
+// ---------------------------------------------------------
+// Logic: Streamed Pipeline (traversal overlapped with hashing)
+// ---------------------------------------------------------
+// Bounded single-producer/multi-consumer channel. The traversal thread
+// pushes entries as it discovers them and workers drain concurrently; the
+// capacity bound keeps the producer from racing ahead and buffering the
+// whole tree in memory.
+template <typename T>
+class BoundedChannel {
+    std::queue<T> items;
+    std::size_t capacity;
+    bool closed = false;
+    std::mutex mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+
+public:
+    explicit BoundedChannel(std::size_t cap) : capacity(cap) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [&] { return items.size() < capacity; });
+        items.push(std::move(item));
+        not_empty.notify_one();
+    }
+
+    // Returns false once the channel is closed and drained.
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_empty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        not_empty.notify_all();
+    }
+};
+
+// How many discovered-but-not-yet-hashed entries the traversal may buffer.
+constexpr std::size_t STREAM_CHANNEL_CAPACITY = 4096;
+
+// Streamed front end of the pipeline: traversal runs on a producer thread
+// while workers drain the channel and compute prefix hashes, so hashing
+// overlaps with enumeration instead of waiting for the full walk. The size
+// pre-filter is preserved with an online gate: the first file seen at a
+// given size is parked, and hashing for that size starts only when a second
+// file proves the size can collide.
+std::vector<FileResult> stream_prefix_scan(const std::vector<std::string>& dirs,
+                                           std::size_t& total_files,
+                                           std::size_t& total_candidates,
+                                           HardlinkMap& hardlinks) {
+    unsigned int num_threads = default_thread_count();
+
+    BoundedChannel<FileEntry> channel(STREAM_CHANNEL_CAPACITY);
+
+    std::atomic<std::size_t> files_seen{0};
+    std::atomic<std::size_t> candidates_seen{0};
+
+    std::thread producer([&]() {
+        traverse_directory(dirs, [&](FileEntry&& entry) {
+            files_seen.fetch_add(1, std::memory_order_relaxed);
+            channel.push(std::move(entry));
+        });
+        channel.close();
+    });
+
+    // Online size gate: released marks a size whose bucket already has two
+    // members; until then one path is parked per size.
+    struct SizeBucket {
+        bool released = false;
+        fs::path parked;
+    };
+    std::unordered_map<std::uintmax_t, SizeBucket> size_gate;
+    std::mutex gate_mutex;
+
+    // Inode gate: the first path seen for a multiply-linked inode becomes the
+    // representative; later links are recorded and never hashed, since they
+    // are the same bytes on disk by definition.
+    std::unordered_map<DevIno, fs::path, DevInoHasher> inode_seen;
+    std::mutex inode_mutex;
+
+    std::vector<std::vector<FileResult>> thread_results(num_threads);
+    ProgressReporter progress(0); // Total unknown while traversal is running
+
+    auto worker = [&](unsigned int thread_id) {
+        std::vector<FileResult>& local = thread_results[thread_id];
+        auto hash_into = [&](const fs::path& p) {
+            candidates_seen.fetch_add(1, std::memory_order_relaxed);
+            Digest h = hash_file_prefix(p);
+            g_stats.files_hashed.fetch_add(1, std::memory_order_relaxed);
+            if (h.ok) local.push_back({p, h});
+        };
+
+        FileEntry entry;
+        while (channel.pop(entry)) {
+            fs::path path = entry.full_path();
+            if (entry.nlink > 1) {
+                std::lock_guard<std::mutex> lock(inode_mutex);
+                auto [it, inserted] = inode_seen.try_emplace(DevIno{entry.dev, entry.ino}, path);
+                if (!inserted) {
+                    hardlinks[it->second.string()].push_back(std::move(path));
+                    continue;
+                }
+            }
+
+            fs::path released_mate;
+            bool hash_now = false;
+            {
+                std::lock_guard<std::mutex> lock(gate_mutex);
+                SizeBucket& bucket = size_gate[entry.size];
+                if (bucket.released) {
+                    hash_now = true;
+                } else if (bucket.parked.empty()) {
+                    bucket.parked = std::move(path);
+                } else {
+                    bucket.released = true;
+                    released_mate = std::move(bucket.parked);
+                    hash_now = true;
+                }
+            }
+            if (!released_mate.empty()) hash_into(released_mate);
+            if (hash_now) hash_into(path);
+        }
+    };
+
+    run_worker_pool(num_threads, worker);
+    producer.join();
+
+    std::vector<FileResult> results;
+    for (auto& local : thread_results) {
+        for (auto& res : local) results.push_back(std::move(res));
+    }
+
+    total_files = files_seen.load();
+    total_candidates = candidates_seen.load();
+    return results;
+}
+
+// ---------------------------------------------------------
+// Logic: Content-Defined Chunking (near-duplicate index)
+// ---------------------------------------------------------
+// Whole-file hashing misses the biggest storage waste on some trees: logs
+// and VM images that are 99% identical but differ in a trailing block.
+// --chunk-dupes splits every scanned file with gear-based content-defined
+// chunking (FastCDC-style: cut points follow the content, so an insertion
+// shifts at most one chunk boundary), indexes the chunk hashes, and reports
+// file pairs sharing at least the requested fraction of chunks. Report
+// only — nothing chunk-level is ever deleted.
+constexpr std::size_t CDC_MIN_CHUNK = 16 * 1024;
+constexpr std::size_t CDC_MAX_CHUNK = 256 * 1024;
+constexpr std::uint64_t CDC_CUT_MASK = (1u << 16) - 1; // ~64KB average chunks
+
+// Chunks shared by more files than this are boilerplate (zero blocks,
+// common headers) and would explode the pair counting quadratically, so
+// they are ignored for similarity purposes.
+constexpr std::size_t CDC_HOT_CHUNK_LIMIT = 64;
+
+unsigned g_chunk_share_percent = 0; // --chunk-dupes; 0 = disabled
+
+// Gear table for the rolling hash. Seeded deterministically so chunk
+// boundaries are stable across runs and nodes.
+const std::array<std::uint64_t, 256>& gear_table() {
+    static const std::array<std::uint64_t, 256> table = [] {
+        std::array<std::uint64_t, 256> t{};
+        std::uint64_t s = 0x9e3779b97f4a7c15ULL;
+        for (auto& v : t) {
+            s ^= s << 13;
+            s ^= s >> 7;
+            s ^= s << 17;
+            v = s;
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Splits one file into content-defined chunks and returns their XXH64
+// digests. Cut when the rolling gear hash hits the mask past the minimum
+// chunk size, or unconditionally at the maximum.
+std::vector<std::uint64_t> chunk_file(const fs::path& path) {
+    const auto& gear = gear_table();
+    std::vector<std::uint64_t> chunks;
+    std::uint64_t roll = 0;
+    XXH64State state;
+    std::size_t chunk_len = 0;
+
+    bool ok = read_file_chunks(path, [&](const char* data, std::size_t len) {
+        std::size_t seg = 0;
+        for (std::size_t i = 0; i < len; ++i) {
+            roll = (roll << 1) + gear[static_cast<unsigned char>(data[i])];
+            ++chunk_len;
+            if (chunk_len >= CDC_MIN_CHUNK &&
+                ((roll & CDC_CUT_MASK) == 0 || chunk_len >= CDC_MAX_CHUNK)) {
+                state.update(data + seg, i + 1 - seg);
+                chunks.push_back(state.digest());
+                state = XXH64State();
+                seg = i + 1;
+                chunk_len = 0;
+                roll = 0;
+            }
+        }
+        if (seg < len) state.update(data + seg, len - seg);
+    });
+    if (!ok) return {};
+
+    if (chunk_len > 0 || chunks.empty()) chunks.push_back(state.digest());
+    return chunks;
+}
+
+struct NearDupPair {
+    fs::path a;
+    fs::path b;
+    std::size_t shared;
+    std::size_t smaller_total; // chunk count of the smaller file
+    unsigned percent;
+};
+
+std::vector<NearDupPair> find_near_duplicates(const std::vector<std::string>& dirs,
+                                              unsigned min_percent) {
+    std::cout << "Chunking files for near-duplicate analysis...\n";
+    Timer phase("chunk analysis", /*record_phase=*/true);
+
+    std::vector<FileEntry> entries = get_file_paths(dirs);
+    std::vector<fs::path> paths;
+    paths.reserve(entries.size());
+    for (auto& e : entries) paths.push_back(e.full_path());
+    entries.clear();
+    entries.shrink_to_fit();
+
+    // Chunk every file in parallel. Per-file chunk lists are deduplicated
+    // (sorted unique) so repeated blocks inside one file count once.
+    std::vector<std::vector<std::uint64_t>> file_chunks(paths.size());
+    std::atomic<std::size_t> next_index{0};
+    std::atomic<std::uint64_t> chunked{0};
+    {
+        ProgressReporter progress(paths.size(), &chunked, "chunked");
+        run_worker_pool(default_thread_count(), [&](unsigned int) {
+            while (true) {
+                std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+                if (i >= paths.size()) break;
+                std::vector<std::uint64_t> chunks = chunk_file(paths[i]);
+                std::sort(chunks.begin(), chunks.end());
+                chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+                file_chunks[i] = std::move(chunks);
+                chunked.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    // Invert: chunk hash -> files containing it.
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> chunk_index;
+    for (std::size_t i = 0; i < file_chunks.size(); ++i) {
+        for (std::uint64_t h : file_chunks[i]) {
+            chunk_index[h].push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    // Count shared chunks per candidate pair. Only pairs that actually
+    // share a chunk are ever touched, and hot chunks are skipped entirely.
+    std::unordered_map<std::uint64_t, std::uint32_t> pair_counts;
+    for (const auto& [hash, files] : chunk_index) {
+        if (files.size() < 2 || files.size() > CDC_HOT_CHUNK_LIMIT) continue;
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            for (std::size_t j = i + 1; j < files.size(); ++j) {
+                std::uint64_t key = (static_cast<std::uint64_t>(files[i]) << 32) | files[j];
+                ++pair_counts[key];
+            }
+        }
+    }
+
+    std::vector<NearDupPair> pairs;
+    for (const auto& [key, shared] : pair_counts) {
+        std::uint32_t a = static_cast<std::uint32_t>(key >> 32);
+        std::uint32_t b = static_cast<std::uint32_t>(key & 0xFFFFFFFFu);
+        std::size_t total_a = file_chunks[a].size();
+        std::size_t total_b = file_chunks[b].size();
+        std::size_t smaller = std::min(total_a, total_b);
+        if (smaller == 0) continue;
+        // Exact duplicates share every chunk both ways; the whole-file
+        // pipeline already reports those.
+        if (shared == total_a && shared == total_b) continue;
+        unsigned percent = static_cast<unsigned>(shared * 100 / smaller);
+        if (percent >= min_percent) {
+            pairs.push_back({paths[a], paths[b], shared, smaller, percent});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const NearDupPair& x, const NearDupPair& y) {
+        return x.percent > y.percent;
+    });
+    return pairs;
+}
+
+void print_near_duplicates(const std::vector<NearDupPair>& pairs, unsigned min_percent) {
+    std::cout << "\nNear-duplicate files (sharing >= " << min_percent << "% of chunks):\n";
+    if (pairs.empty()) {
+        std::cout << "  none found\n";
+        return;
+    }
+    for (const auto& p : pairs) {
+        std::cout << "  " << p.percent << "% (" << p.shared << "/" << p.smaller_total
+                  << " chunks): " << p.a.string() << " <-> " << p.b.string() << "\n";
+    }
+}
+
+void display_collisions(const CollisionMap& collisions, const HardlinkMap& hardlinks,
+                        const std::vector<NearDupPair>* near_dupes = nullptr) {
+    // Representatives whose links were shown inline under a collision group;
+    // whatever is left in the map afterwards is a pure hardlink group whose
+    // inode has no content twin, and it still has to be reported.
+    std::unordered_set<std::string> shown_inline;
+    for (const auto& [hash, paths] : collisions) {
+        std::cout << "\nThe following files share the same hash (" << hash.hex() << "):\n";
+        for (size_t i = 0; i < paths.size(); ++i) {
+            std::cout << i + 1 << " - " << paths[i].string() << "\n";
+            // Hardlinks of this path share its storage: they are listed for
+            // completeness but occupy no extra space and are never deleted.
+            auto hl = hardlinks.find(paths[i].string());
+            if (hl != hardlinks.end()) {
+                shown_inline.insert(hl->first);
+                for (const auto& link : hl->second) {
+                    std::cout << "      [hardlink, same inode] " << link.string() << "\n";
+                }
+            }
+        }
+    }
+    bool printed_pure_hardlinks = false;
+    for (const auto& [representative, links] : hardlinks) {
+        if (shown_inline.count(representative)) continue;
+        std::cout << "\nThe following files are hardlinks to the same inode (no extra space used):\n";
+        std::cout << "1 - " << representative << "\n";
+        for (size_t i = 0; i < links.size(); ++i) {
+            std::cout << i + 2 << " - " << links[i].string() << "\n";
+        }
+        printed_pure_hardlinks = true;
+    }
+    if (collisions.empty() && !printed_pure_hardlinks) {
+        std::cout << "No hash collisions found.\n";
+    }
+    if (near_dupes) {
+        print_near_duplicates(*near_dupes, g_chunk_share_percent);
+    }
+}
+
+// Orders by number of directory separators (depth), simplest/shortest path
+// first. The front of a group sorted this way is the file that is kept; the
+// verification stage uses the same ordering so it compares against the
+// actual keeper.
+bool shallower_path(const fs::path& a, const fs::path& b) {
+    std::string sa = a.string();
+    std::string sb = b.string();
+    return std::count(sa.begin(), sa.end(), fs::path::preferred_separator) <
+           std::count(sb.begin(), sb.end(), fs::path::preferred_separator);
+}
+
+void delete_duplicates(CollisionMap& collisions) {
+    // Victims are batched by parent directory and unlinked by a worker pool.
+    // Clustered unlinks within one directory keep the dentry cache hot, and
+    // on NFS the round-trips overlap across workers instead of serializing —
+    // a 1M-file cleanup at ~200 unlinks/s was over an hour of tail latency
+    // after hashing had already finished.
+    std::unordered_map<std::string, std::vector<fs::path>> by_parent;
+    std::size_t total_victims = 0;
+    for (auto& [hash, paths] : collisions) {
+        if (paths.size() < 2) continue;
+        std::sort(paths.begin(), paths.end(), shallower_path);
+
+        // Keep the first one (index 0), delete the rest
+        for (size_t i = 1; i < paths.size(); ++i) {
+            by_parent[paths[i].parent_path().string()].push_back(std::move(paths[i]));
+            ++total_victims;
+        }
+    }
+    if (by_parent.empty()) return;
+
+    std::vector<std::vector<fs::path>> batches;
+    batches.reserve(by_parent.size());
+    for (auto& [dir, victims] : by_parent) batches.push_back(std::move(victims));
+
+    std::atomic<std::size_t> next_batch{0};
+    std::atomic<std::uint64_t> deleted{0};
+    std::atomic<std::uint64_t> failed{0};
+    std::mutex output_mutex;
+
+    unsigned int num_threads =
+        std::min<unsigned int>(default_thread_count(), batches.size());
+
+    ProgressReporter progress(total_victims, &deleted, "deleted");
+
+    auto worker = [&]() {
+        while (true) {
+            std::size_t b = next_batch.fetch_add(1, std::memory_order_relaxed);
+            if (b >= batches.size()) break;
+            for (const auto& victim : batches[b]) {
+                try {
+                    if (fs::remove(victim)) {
+                        deleted.fetch_add(1, std::memory_order_relaxed);
+                        std::lock_guard<std::mutex> lock(output_mutex);
+                        std::cout << "Deleted: " << victim << "\n";
+                    } else {
+                        failed.fetch_add(1, std::memory_order_relaxed);
+                        std::lock_guard<std::mutex> lock(output_mutex);
+                        std::cerr << "Failed to delete: " << victim << "\n";
+                    }
+                } catch (const fs::filesystem_error& e) {
+                    failed.fetch_add(1, std::memory_order_relaxed);
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    std::cerr << "Error deleting " << victim << ": " << e.what() << "\n";
+                }
+            }
+        }
+    };
+
+    run_worker_pool(num_threads, [&](unsigned int) { worker(); });
+
+    std::cout << "Deleted " << deleted.load() << " duplicates";
+    if (failed.load()) std::cout << ", " << failed.load() << " failed";
+    std::cout << ".\n";
+}
+
+// ---------------------------------------------------------
+// Logic: Link Replacement
+// ---------------------------------------------------------
+// --link reclaims the same space as --delete without removing any path:
+// each victim is replaced by a hardlink to its group's keeper, or by a
+// reflink clone (FICLONE, XFS/btrfs) where hardlinking is refused. The
+// replacement goes through a temporary name and rename(2), so the victim's
+// path always resolves to complete data — even if we crash mid-way.
+
+bool replace_with_hardlink(const fs::path& keeper, const fs::path& victim) {
+    fs::path tmp = victim;
+    tmp += ".fdlink.tmp";
+    if (::link(keeper.c_str(), tmp.c_str()) != 0) return false;
+    if (::rename(tmp.c_str(), victim.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool replace_with_reflink(const fs::path& keeper, const fs::path& victim) {
+#if defined(__linux__) && defined(FICLONE)
+    struct stat st;
+    if (::stat(victim.c_str(), &st) != 0) return false;
+
+    int src = ::open(keeper.c_str(), O_RDONLY);
+    if (src < 0) return false;
+
+    fs::path tmp = victim;
+    tmp += ".fdlink.tmp";
+    int dst = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 07777);
+    if (dst < 0) {
+        ::close(src);
+        return false;
+    }
+
+    bool ok = ::ioctl(dst, FICLONE, src) == 0;
+    ::close(dst);
+    ::close(src);
+    if (!ok || ::rename(tmp.c_str(), victim.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+#else
+    (void)keeper;
+    (void)victim;
+    return false;
+#endif
+}
+
+void link_duplicates(CollisionMap& collisions) {
+    std::size_t hardlinked = 0, reflinked = 0, failed = 0;
+    for (auto& [hash, paths] : collisions) {
+        if (paths.size() < 2) continue;
+        std::sort(paths.begin(), paths.end(), shallower_path);
+        const fs::path& keeper = paths[0];
+        for (std::size_t i = 1; i < paths.size(); ++i) {
+            if (replace_with_hardlink(keeper, paths[i])) {
+                std::cout << "Hardlinked: " << paths[i] << " -> " << keeper << "\n";
+                ++hardlinked;
+            } else if (replace_with_reflink(keeper, paths[i])) {
+                std::cout << "Reflinked: " << paths[i] << " -> " << keeper << "\n";
+                ++reflinked;
+            } else {
+                std::cerr << "Failed to link " << paths[i] << " (cross-device, or filesystem "
+                          << "supports neither hardlinks nor reflinks here)\n";
+                ++failed;
+            }
+        }
+    }
+    std::cout << "Replaced " << hardlinked << " duplicates with hardlinks, "
+              << reflinked << " with reflinks";
+    if (failed) std::cout << ", " << failed << " left untouched";
+    std::cout << ".\n";
+}
+
+// ---------------------------------------------------------
+// Logic: Streaming Results Output
+// ---------------------------------------------------------
+// --output streams collision groups as JSON Lines: one object per group,
+// written through a large explicit buffer as groups are walked. Downstream
+// tooling consumes this directly, and a 2M-group result no longer takes
+// minutes of per-path terminal I/O.
+std::string json_escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 8);
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+void write_collisions_jsonl(const CollisionMap& collisions, const HardlinkMap& hardlinks,
+                            const std::string& out_path) {
+    // A dedicated 1MB stream buffer keeps the write path to a handful of
+    // syscalls per flush instead of one per group. Declared before the
+    // stream so it outlives the ofstream destructor's final flush.
+    std::vector<char> stream_buffer(1 << 20);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(stream_buffer.data(), stream_buffer.size());
+    out.open(out_path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Error: could not open output file: " << out_path << "\n";
+        return;
+    }
+
+    std::string line;
+    for (const auto& [hash, paths] : collisions) {
+        line.clear();
+        line += "{\"hash\":\"";
+        line += hash.hex();
+        line += "\",\"files\":[";
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            if (i) line += ',';
+            line += "{\"path\":\"";
+            line += json_escape(paths[i].string());
+            line += '"';
+            auto hl = hardlinks.find(paths[i].string());
+            if (hl != hardlinks.end()) {
+                line += ",\"hardlinks\":[";
+                for (std::size_t j = 0; j < hl->second.size(); ++j) {
+                    if (j) line += ',';
+                    line += '"';
+                    line += json_escape(hl->second[j].string());
+                    line += '"';
+                }
+                line += ']';
+            }
+            line += '}';
+        }
+        line += "]}\n";
+        out.write(line.data(), line.size());
+    }
+
+    out.close();
+    if (!out) {
+        std::cerr << "Error: failed writing output file: " << out_path << "\n";
+        return;
+    }
+    std::cout << "Wrote " << collisions.size() << " collision groups to " << out_path << "\n";
+}
+
+// Re-hash every member of the final collision groups with the configured
+// cryptographic digest (MD5 by default, see --digest) and regroup. The fast
+// hash decides what is a candidate; this pass decides what is safe to
+// delete, so an XXH64 collision can never cost us a file.
+CollisionMap confirm_collisions_crypto(const CollisionMap& collisions) {
+    std::vector<fs::path> members;
+    for (const auto& [hash, paths] : collisions) {
+        for (const auto& p : paths) members.push_back(p);
+    }
+
+    std::vector<FileResult> crypto_results = process_files_parallel(members, HashMode::Crypto);
+
+    CollisionMap confirmed;
+    for (auto& res : crypto_results) {
+        confirmed[res.hash].push_back(std::move(res.path));
+    }
+    for (auto it = confirmed.begin(); it != confirmed.end();) {
+        if (it->second.size() < 2) it = confirmed.erase(it);
+        else ++it;
+    }
+
+    if (confirmed.size() != collisions.size()) {
+        std::cout << crypto_md_name() << " confirmation split " << collisions.size() << " fast-hash groups into "
+                  << confirmed.size() << " verified groups.\n";
+    }
+    return confirmed;
+}
+
+// ---------------------------------------------------------
+// Logic: Byte-for-Byte Verification
+// ---------------------------------------------------------
+// The last gate before deletion: no digest, however strong, is proof. Each
+// victim is compared against its group's keeper chunk by chunk, stopping at
+// the first differing byte, so the destructive path only ever acts on files
+// proven identical.
+
+// Chunked comparison of two files. Returns false on any size or content
+// difference, and also on any read error — an unreadable file is never
+// "verified identical".
+bool files_identical(const fs::path& a, const fs::path& b) {
+    struct stat st_a, st_b;
+    if (::stat(a.c_str(), &st_a) != 0 || ::stat(b.c_str(), &st_b) != 0) return false;
+    if (st_a.st_size != st_b.st_size) return false;
+
+    int fd_a = ::open(a.c_str(), O_RDONLY);
+    if (fd_a < 0) return false;
+    int fd_b = ::open(b.c_str(), O_RDONLY);
+    if (fd_b < 0) {
+        ::close(fd_a);
+        return false;
+    }
+
+    static thread_local std::vector<char> buf_a(READ_BUFFER_SIZE);
+    static thread_local std::vector<char> buf_b(READ_BUFFER_SIZE);
+
+    bool identical = true;
+    off_t offset = 0;
+    off_t remaining = st_a.st_size;
+    while (remaining > 0) {
+        std::size_t want = static_cast<std::size_t>(
+            std::min<off_t>(remaining, static_cast<off_t>(READ_BUFFER_SIZE)));
+        ssize_t got_a = ::pread(fd_a, buf_a.data(), want, offset);
+        ssize_t got_b = ::pread(fd_b, buf_b.data(), want, offset);
+        if (got_a <= 0 || got_a != got_b ||
+            std::memcmp(buf_a.data(), buf_b.data(), static_cast<std::size_t>(got_a)) != 0) {
+            identical = false;
+            break;
+        }
+        offset += got_a;
+        remaining -= got_a;
+    }
+
+    ::close(fd_a);
+    ::close(fd_b);
+    return identical;
+}
+
+// Sorts each group so its keeper is at the front (same ordering as
+// delete_duplicates()), then compares every victim against the keeper in
+// parallel. Victims that fail the comparison are dropped from their group,
+// so whatever delete_duplicates() sees afterwards is verified identical.
+void verify_collisions_bytes(CollisionMap& collisions) {
+    struct VerifyPair {
+        const fs::path* keeper;
+        const fs::path* victim;
+    };
+    std::vector<VerifyPair> pairs;
+    for (auto& [hash, paths] : collisions) {
+        std::sort(paths.begin(), paths.end(), shallower_path);
+        for (std::size_t i = 1; i < paths.size(); ++i) {
+            pairs.push_back({&paths[0], &paths[i]});
+        }
+    }
+
+    std::vector<char> identical(pairs.size(), 0);
+    std::atomic<std::size_t> next_index{0};
+
+    unsigned int num_threads = std::min<unsigned int>(
+        default_thread_count(), pairs.size() ? pairs.size() : 1);
+
+    run_worker_pool(num_threads, [&](unsigned int) {
+        while (true) {
+            std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+            if (i >= pairs.size()) break;
+            identical[i] = files_identical(*pairs[i].keeper, *pairs[i].victim) ? 1 : 0;
+        }
+    });
+
+    // Rebuild the groups, dropping victims that failed verification. Groups
+    // are walked in the same order as above so pair indices line up.
+    std::size_t pair_index = 0;
+    std::size_t verified = 0;
+    std::size_t dropped = 0;
+    for (auto& [hash, paths] : collisions) {
+        std::vector<fs::path> kept;
+        kept.push_back(std::move(paths[0]));
+        for (std::size_t i = 1; i < paths.size(); ++i, ++pair_index) {
+            if (identical[pair_index]) {
+                kept.push_back(std::move(paths[i]));
+                ++verified;
+            } else {
+                std::cerr << "Dropping unverified duplicate (differs from keeper or unreadable): "
+                          << paths[i].string() << "\n";
+                ++dropped;
+            }
+        }
+        paths = std::move(kept);
+    }
+    for (auto it = collisions.begin(); it != collisions.end();) {
+        if (it->second.size() < 2) it = collisions.erase(it);
+        else ++it;
+    }
+
+    std::cout << "Byte-for-byte verification: " << verified << " duplicates verified identical";
+    if (dropped) std::cout << ", " << dropped << " dropped";
+    std::cout << ".\n";
+}
+
+// ---------------------------------------------------------
+// Logic: Spill-to-Disk Aggregation
+// ---------------------------------------------------------
+// --max-mem caps how much of the hash->paths aggregation is held in memory.
+// Results are buffered until the cap is hit, then sorted by digest and
+// written out as a sorted run file; finish() merges all runs with the final
+// buffer in a single streaming pass and materializes only the groups that
+// actually collide. Peak aggregation memory is then the cap plus the (small)
+// duplicate set, instead of one map entry per hashed file.
+std::size_t g_max_mem_bytes = 0; // 0 = unbounded, keep everything in memory
+
+class SpillAggregator {
+    std::vector<FileResult> buffer;
+    std::size_t buffered_bytes = 0;
+    std::size_t budget;
+    std::vector<fs::path> run_files;
+    bool spill_failed = false;
+
+    static bool digest_less(const Digest& a, const Digest& b) {
+        return std::memcmp(a.bytes.data(), b.bytes.data(), a.bytes.size()) < 0;
+    }
+
+    static void sort_by_digest(std::vector<FileResult>& results) {
+        std::sort(results.begin(), results.end(), [](const FileResult& a, const FileResult& b) {
+            return digest_less(a.hash, b.hash);
+        });
+    }
+
+    // Sequential reader over one sorted run. Record layout: 16 digest bytes,
+    // u32 path length, path bytes.
+    struct RunReader {
+        std::ifstream in;
+        FileResult current;
+        bool valid = false;
+
+        explicit RunReader(const fs::path& run) : in(run, std::ios::binary) { advance(); }
+
+        void advance() {
+            valid = false;
+            if (!in.read(reinterpret_cast<char*>(current.hash.bytes.data()),
+                         current.hash.bytes.size())) return;
+            std::uint32_t len = 0;
+            if (!in.read(reinterpret_cast<char*>(&len), sizeof(len))) return;
+            std::string s(len, '\0');
+            if (len && !in.read(s.data(), len)) return;
+            current.hash.ok = true;
+            current.path = fs::path(std::move(s));
+            valid = true;
+        }
+    };
+
+    void flush_run() {
+        if (buffer.empty()) return;
+        sort_by_digest(buffer);
+
+        fs::path run = fs::temp_directory_path() /
+            ("find_dupes_run_" + std::to_string(::getpid()) + "_" +
+             std::to_string(run_files.size()));
+        std::ofstream out(run, std::ios::binary | std::ios::trunc);
+        for (const auto& res : buffer) {
+            out.write(reinterpret_cast<const char*>(res.hash.bytes.data()), res.hash.bytes.size());
+            std::string s = res.path.string();
+            std::uint32_t len = static_cast<std::uint32_t>(s.size());
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(s.data(), len);
+        }
+        if (!out) {
+            // Disk trouble: better to blow the ceiling than to lose results.
+            std::cerr << "Warning: failed to write spill run " << run.string()
+                      << ", keeping aggregation in memory\n";
+            std::error_code ec;
+            fs::remove(run, ec);
+            spill_failed = true;
+            return;
+        }
+        run_files.push_back(run);
+        buffer.clear();
+        buffered_bytes = 0;
+    }
+
+public:
+    explicit SpillAggregator(std::size_t budget_bytes) : budget(budget_bytes) {}
+
+    ~SpillAggregator() {
+        std::error_code ec;
+        for (const auto& run : run_files) fs::remove(run, ec);
+    }
+
+    void add(FileResult&& res) {
+        buffered_bytes += sizeof(FileResult) + res.path.native().size();
+        buffer.push_back(std::move(res));
+        if (!spill_failed && buffered_bytes >= budget) flush_run();
+    }
+
+    // Merge the sorted runs with the (sorted) final buffer and keep only
+    // digests with 2+ members. Runs are few, so a linear min-scan per record
+    // is simpler than a heap and just as fast.
+    CollisionMap finish() {
+        sort_by_digest(buffer);
+
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for (const auto& run : run_files) {
+            readers.push_back(std::make_unique<RunReader>(run));
+        }
+
+        CollisionMap collisions;
+        Digest group_digest;
+        std::vector<fs::path> group;
+        auto emit_group = [&]() {
+            if (group.size() > 1) collisions[group_digest] = std::move(group);
+            group.clear();
+        };
+        auto consume = [&](FileResult&& res) {
+            if (group.empty() || !(res.hash == group_digest)) {
+                emit_group();
+                group_digest = res.hash;
+            }
+            group.push_back(std::move(res.path));
+        };
+
+        std::size_t buffer_index = 0;
+        while (true) {
+            RunReader* best = nullptr;
+            for (auto& reader : readers) {
+                if (reader->valid &&
+                    (!best || digest_less(reader->current.hash, best->current.hash))) {
+                    best = reader.get();
+                }
+            }
+            bool take_buffer = buffer_index < buffer.size() &&
+                (!best || digest_less(buffer[buffer_index].hash, best->current.hash));
+
+            if (take_buffer) {
+                consume(std::move(buffer[buffer_index++]));
+            } else if (best) {
+                consume(std::move(best->current));
+                best->advance();
+            } else {
+                break;
+            }
+        }
+        emit_group();
+
+        buffer.clear();
+        buffer.shrink_to_fit();
+        return collisions;
+    }
+};
+
+// ---------------------------------------------------------
+// Main Control
+// ---------------------------------------------------------
+void clean_up(const std::vector<std::string>& dirs, bool show_collisions, bool delete_flag, bool stream,
+              bool link_flag, const std::string& output_path = "") {
+    Timer timer("clean_up"); // Helper class replicates the python decorator
+
+    std::vector<FileResult> prefix_results;
+    std::size_t total_files = 0;
+    std::size_t total_candidates = 0;
+    HardlinkMap hardlinks;
+
+    if (stream) {
+        // Streamed mode: traversal and prefix hashing run concurrently, so
+        // hashing starts while the walk (slow on cold NFS metadata) is still
+        // in flight.
+        std::cout << "Streaming traversal and prefix hashing...\n";
+        Timer phase("traversal + prefix (streamed)", /*record_phase=*/true);
+        prefix_results = stream_prefix_scan(dirs, total_files, total_candidates, hardlinks);
+        std::cout << "Found " << total_files << " files, "
+                  << total_candidates << " candidates after size pre-filter.\n";
+    } else {
+        std::cout << "Gathering file paths...\n";
+        std::vector<FileEntry> file_paths;
+        {
+            Timer phase("traversal", /*record_phase=*/true);
+            file_paths = get_file_paths(dirs);
+        }
+
+        // Hardlink dedup: paths sharing a (dev, inode) are the same bytes on
+        // disk, so only one representative per inode is hashed and the rest
+        // are recorded for display. This both avoids reading the same data N
+        // times and keeps delete_duplicates() away from links that share
+        // storage anyway.
+        std::unordered_map<DevIno, fs::path, DevInoHasher> inode_seen;
+        auto new_end = std::remove_if(file_paths.begin(), file_paths.end(), [&](FileEntry& entry) {
+            if (entry.nlink <= 1) return false;
+            auto [it, inserted] = inode_seen.try_emplace(DevIno{entry.dev, entry.ino}, entry.full_path());
+            if (inserted) return false;
+            hardlinks[it->second.string()].push_back(entry.full_path());
+            return true;
+        });
+        file_paths.erase(new_end, file_paths.end());
+        total_files = file_paths.size();
+
+        // Pre-filter: two files can only be duplicates if they have the same
+        // byte size, so bucket by size and only hash buckets with 2+ members.
+        // On typical trees most files have a unique size, so this skips the
+        // bulk of the MD5 I/O entirely. Entries stay in their interned form
+        // here; full paths are only materialized for the buckets that can
+        // actually collide.
+        std::unordered_map<std::uintmax_t, std::vector<FileEntry>> size_groups;
+        for (auto& entry : file_paths) {
+            size_groups[entry.size].push_back(std::move(entry));
+        }
+        file_paths.clear();
+        file_paths.shrink_to_fit();
+
+        std::vector<fs::path> candidates;
+        for (auto& [size, entries] : size_groups) {
+            if (entries.size() > 1) {
+                for (auto& e : entries) candidates.push_back(e.full_path());
+            }
+        }
+        total_candidates = candidates.size();
+        std::cout << "Found " << total_files << " files, "
+                  << total_candidates << " candidates after size pre-filter.\n";
+
+        // Cheap tier: hash only the first 4KB of each candidate. Most same-size
+        // non-duplicates already differ in their first block, so this disqualifies
+        // them with a single small read instead of a full-file scan.
+        Timer phase("prefix hashing", /*record_phase=*/true);
+        prefix_results = process_files_parallel(candidates, HashMode::Prefix);
+    }
+
+    std::unordered_map<Digest, std::vector<fs::path>, DigestHasher> prefix_groups;
+    for (auto& res : prefix_results) {
+        prefix_groups[res.hash].push_back(std::move(res.path));
+    }
+
+    std::vector<fs::path> survivors;
+    for (auto& [hash, paths] : prefix_groups) {
+        if (paths.size() > 1) {
+            for (auto& p : paths) survivors.push_back(std::move(p));
+        }
+    }
+
+    std::cout << total_candidates << " candidates, " << survivors.size()
+              << " survive the prefix-hash tier. Hashing in parallel...\n";
+
+    // Consult the persistent cache before doing any full-file work: files
+    // whose (size, mtime) are unchanged since the last run reuse the stored
+    // digest instead of being re-read.
+    HashCache cache;
+    cache.load(HASH_CACHE_FILE);
+
+    // Results flow either into the sharded concurrent aggregator (default:
+    // workers insert as digests complete, no intermediate result vector) or
+    // into a plain vector feeding the memory-bounded spill path (--max-mem).
+    ShardedAggregator sharded;
+    std::vector<FileResult> results;
+    std::size_t cached_count = 0;
+    std::unordered_map<std::uint64_t, std::vector<fs::path>> to_hash_by_device;
+    std::size_t to_hash_count = 0;
+    for (auto& p : survivors) {
+        struct stat st;
+        if (::stat(p.c_str(), &st) != 0) continue;
+        Digest cached = cache.lookup(p, static_cast<std::uintmax_t>(st.st_size),
+                                     HashCache::mtime_of(st));
+        if (cached.ok) {
+            ++cached_count;
+            if (g_max_mem_bytes) results.push_back({std::move(p), cached});
+            else sharded.insert({std::move(p), cached});
+        } else {
+            to_hash_by_device[static_cast<std::uint64_t>(st.st_dev)].push_back(std::move(p));
+            ++to_hash_count;
+        }
+    }
+
+    std::cout << cached_count << " hashes served from cache, " << to_hash_count
+              << " files to hash across " << to_hash_by_device.size() << " device(s).\n";
+
+    // Full-file hashing only on cache misses, one pool per backing device.
+    // Workers store each finished digest into the cache as they go and a
+    // Checkpointer flushes it to disk periodically, so an interrupted scan
+    // resumes from its last checkpoint on the next run.
+    {
+        Timer phase("full-file hashing", /*record_phase=*/true);
+        g_active_cache = &cache;
+        Checkpointer checkpointer(cache, HASH_CACHE_FILE);
+        std::vector<FileResult> hashed = process_files_per_device(
+            to_hash_by_device, HashMode::Fast, g_max_mem_bytes ? nullptr : &sharded);
+        g_active_cache = nullptr;
+        for (auto& res : hashed) {
+            results.push_back(std::move(res));
+        }
+    }
+    cache.save(HASH_CACHE_FILE);
+
+    CollisionMap collisions;
+    {
+        Timer phase("aggregation", /*record_phase=*/true);
+        if (g_max_mem_bytes) {
+            // Memory-bounded: results spill to sorted on-disk runs once the
+            // ceiling is hit and only colliding groups are materialized.
+            SpillAggregator aggregator(g_max_mem_bytes);
+            for (auto& res : results) aggregator.add(std::move(res));
+            results.clear();
+            results.shrink_to_fit();
+            collisions = aggregator.finish();
+        } else {
+            // Workers already inserted into the shards; what is left is the
+            // parallel singleton sweep and the merge of surviving groups.
+            collisions = sharded.finish();
+        }
+    }
+
+    // Optional chunk-level pass over the whole tree; exact duplicates are
+    // already grouped above, this finds the files that almost match.
+    std::vector<NearDupPair> near_dupes;
+    if (g_chunk_share_percent) {
+        near_dupes = find_near_duplicates(dirs, g_chunk_share_percent);
+    }
+
+    g_stats.print_breakdown();
+
+    if (!output_path.empty()) {
+        write_collisions_jsonl(collisions, hardlinks, output_path);
+    }
+
+    if (show_collisions) {
+        display_collisions(collisions, hardlinks,
+                           g_chunk_share_percent ? &near_dupes : nullptr);
+    } else {
+        std::cout << "Duplicates were found for " << collisions.size() << " individual files\n\n";
+        if (g_chunk_share_percent) {
+            print_near_duplicates(near_dupes, g_chunk_share_percent);
+        }
+    }
+
+    if (delete_flag || link_flag) {
+        const char* action = link_flag ? "Link" : "Delete";
+        if (collisions.empty()) {
+            std::cout << "Nothing to " << (link_flag ? "link" : "delete")
+                      << ". No duplicate files found\n";
+            return;
+        }
+
+        std::cout << "Proceed to " << action << "? Hit Enter to Continue: ";
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Wait for enter
+        if (std::cin.peek() == '\n') std::cin.ignore();
+
+        if (link_flag) {
+            std::cout << "\n\tWARNING: Replacing duplicates with links changes storage sharing!\n"
+                      << "\t- Every duplicate will point at the instance with the shortest path.\n"
+                      << "\t- After hardlinking, writes through one path are visible through all.\n\n";
+        } else {
+            std::cout << "\n\tWARNING: Deleting duplicate files can be dangerous!\n"
+                      << "\t- This tool will delete all duplicate instances.\n"
+                      << "\t- Only the single instance with the shortest path will be kept.\n\n";
+        }
+
+        if (!show_collisions) {
+            std::cout << "Do you want to see all the files which share the same binary data? (yes/no): ";
+            std::string resp;
+            std::cin >> resp;
+            if (resp == "yes" || resp == "y") {
+                display_collisions(collisions, hardlinks);
+            }
+        }
+
+        std::cout << "Do you know what you are doing (yes/no)? ";
+        std::string confirm;
+        std::cin >> confirm;
+
+        if (confirm == "yes" || confirm == "y") {
+            // Confirm fast-hash groups cryptographically, then prove every victim
+            // byte-for-byte identical to its keeper before anything is
+            // removed or replaced.
+            std::cout << "Verifying collision groups with " << crypto_md_name() << " before "
+                      << (link_flag ? "linking" : "deletion") << "...\n";
+            collisions = confirm_collisions_crypto(collisions);
+            verify_collisions_bytes(collisions);
+            if (link_flag) {
+                link_duplicates(collisions);
+            } else {
+                delete_duplicates(collisions);
+            }
+        } else {
+            std::cout << "Aborted " << (link_flag ? "linking" : "deletion") << ".\n";
+        }
+    }
+}
+
+// ---------------------------------------------------------
+// Logic: Distributed Scan (coordinator / worker)
+// ---------------------------------------------------------
+// A single scanner cannot keep up with a multi-PB filer. --workers runs
+// this process as the coordinator: the scan roots are partitioned by
+// top-level subtree and assigned round-robin to `find_dupes --worker`
+// processes on other nodes (which see the same mount paths). Each worker
+// full-hashes its subtrees and streams back (path, digest) records; the
+// coordinator feeds everything — remote records plus any loose top-level
+// files it hashes itself — through the sharded aggregator for one merged
+// collision pass. The protocol is deliberately simple: newline-framed
+// SCAN/DONE assignments one way, length-prefixed binary records the other.
+// Workers skip the size and prefix pre-filters: those are only sound with a
+// global view, and a digest of every file is exactly what the merge needs.
+constexpr int WORKER_DEFAULT_PORT = 7677;
+constexpr std::uint32_t RECORD_END_OF_STREAM = 0xFFFFFFFFu;
+
+bool write_all(int fd, const void* buf, std::size_t n) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+bool read_all(int fd, void* buf, std::size_t n) {
+    char* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t r = ::read(fd, p, n);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return false;
+        }
+        p += r;
+        n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+// Assignment lines are a handful of bytes, so byte-at-a-time reads are fine.
+bool read_line(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (read_all(fd, &c, 1)) {
+        if (c == '\n') return true;
+        line += c;
+    }
+    return false;
+}
+
+// One coordinator session: consume SCAN assignments, full-hash each subtree
+// and stream its records back, then send the end-of-stream sentinel.
+void serve_worker_session(int conn) {
+    std::size_t sent = 0;
+    std::string line;
+    while (read_line(conn, line)) {
+        if (line == "DONE") break;
+        if (line.rfind("SCAN ", 0) != 0) {
+            std::cerr << "worker: unrecognized command: " << line << "\n";
+            break;
+        }
+        std::string dir = line.substr(5);
+        std::cout << "worker: scanning " << dir << "\n";
+
+        std::vector<FileEntry> entries = get_file_paths({dir});
+        std::vector<fs::path> paths;
+        paths.reserve(entries.size());
+        for (auto& e : entries) paths.push_back(e.full_path());
+        entries.clear();
+        entries.shrink_to_fit();
+
+        std::vector<FileResult> results = process_files_parallel(paths, HashMode::Fast);
+        for (const auto& res : results) {
+            std::string s = res.path.string();
+            std::uint32_t len = static_cast<std::uint32_t>(s.size());
+            if (!write_all(conn, &len, sizeof(len)) ||
+                !write_all(conn, s.data(), len) ||
+                !write_all(conn, res.hash.bytes.data(), res.hash.bytes.size())) {
+                std::cerr << "worker: coordinator connection lost\n";
+                return;
+            }
+        }
+        sent += results.size();
+    }
+    std::uint32_t end = RECORD_END_OF_STREAM;
+    write_all(conn, &end, sizeof(end));
+    std::cout << "worker: session complete, " << sent << " records sent\n";
+}
+
+int run_worker(int port) {
+    // A peer that vanishes mid-stream must surface as a write_all failure,
+    // not a SIGPIPE that kills the daemon out of its accept loop.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    int srv = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (srv < 0) {
+        std::cerr << "Error: socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    int one = 1;
+    ::setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    if (::bind(srv, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(srv, 4) != 0) {
+        std::cerr << "Error: cannot listen on port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(srv);
+        return 1;
+    }
+
+    std::cout << "worker: listening on port " << port << "\n";
+    while (true) {
+        int conn = ::accept(srv, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept: " << std::strerror(errno) << "\n";
+            break;
+        }
+        serve_worker_session(conn);
+        ::close(conn);
+    }
+    ::close(srv);
+    return 1;
+}
+
+int connect_worker(const std::string& spec) {
+    auto colon = spec.rfind(':');
+    std::string host = colon == std::string::npos ? spec : spec.substr(0, colon);
+    std::string port = colon == std::string::npos ? std::to_string(WORKER_DEFAULT_PORT)
+                                                  : spec.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(res);
+    return fd;
+}
+
+int run_coordinator(const std::vector<std::string>& dirs, const std::vector<std::string>& workers,
+                    bool show_collisions, const std::string& output_path) {
+    Timer timer("distributed scan");
+
+    // A worker that dies mid-assignment must surface as a write_all failure,
+    // not a SIGPIPE terminating the coordinator.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    // Static partition: every top-level subdirectory of a scan root is one
+    // assignment; loose files directly in a root are hashed locally while
+    // the workers run.
+    std::vector<std::string> tasks;
+    std::vector<fs::path> local_files;
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        if (!fs::exists(dir, ec) || !fs::is_directory(dir, ec)) {
+            std::cerr << "Error: Directory not found or inaccessible: " << dir << "\n";
+            continue;
+        }
+        for (fs::directory_iterator it(fs::absolute(dir), ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code ec_type;
+            if (it->is_directory(ec_type) && !it->is_symlink(ec_type)) {
+                tasks.push_back(it->path().string());
+            } else if (it->is_regular_file(ec_type)) {
+                local_files.push_back(it->path());
+            }
+        }
+    }
+    if (tasks.empty() && local_files.empty()) {
+        std::cerr << "Error: nothing to scan\n";
+        return 1;
+    }
+
+    std::vector<int> conns;
+    for (const auto& spec : workers) {
+        int fd = connect_worker(spec);
+        if (fd < 0) {
+            std::cerr << "Error: cannot reach worker " << spec << "\n";
+            for (int c : conns) ::close(c);
+            return 1;
+        }
+        conns.push_back(fd);
+    }
+
+    // Remote records and locally hashed loose files meet in the sharded
+    // aggregator, which is already safe for concurrent inserts.
+    ShardedAggregator aggregator;
+    std::atomic<std::uint64_t> received{0};
+
+    // Readers must be draining before any assignments go out: a worker that
+    // starts streaming records fills its send buffer and stops reading
+    // commands, and with enough queued SCAN lines the coordinator's blocking
+    // write_all would then deadlock against it.
+    std::vector<std::thread> readers;
+    for (int c : conns) {
+        readers.emplace_back([&, c]() {
+            while (true) {
+                std::uint32_t len;
+                if (!read_all(c, &len, sizeof(len)) || len == RECORD_END_OF_STREAM) break;
+                std::string s(len, '\0');
+                Digest d;
+                if (len && !read_all(c, s.data(), len)) break;
+                if (!read_all(c, d.bytes.data(), d.bytes.size())) break;
+                d.ok = true;
+                aggregator.insert({fs::path(std::move(s)), d});
+                received.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::cout << "Distributing " << tasks.size() << " subtrees across "
+              << conns.size() << " worker(s)...\n";
+    bool send_ok = true;
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        std::string cmd = "SCAN " + tasks[i] + "\n";
+        send_ok &= write_all(conns[i % conns.size()], cmd.data(), cmd.size());
+    }
+    for (int c : conns) {
+        send_ok &= write_all(c, "DONE\n", 5);
+    }
+    if (!send_ok) {
+        // Wake any reader still blocked on its socket before bailing out.
+        std::cerr << "Error: lost a worker connection while assigning subtrees\n";
+        for (int c : conns) ::shutdown(c, SHUT_RDWR);
+        for (auto& t : readers) {
+            if (t.joinable()) t.join();
+        }
+        for (int c : conns) ::close(c);
+        return 1;
+    }
+
+    process_files_parallel(local_files, HashMode::Fast, 0, /*report_progress=*/false, &aggregator);
+
+    for (auto& t : readers) {
+        if (t.joinable()) t.join();
+    }
+    for (int c : conns) ::close(c);
+
+    std::cout << received.load() << " records received from workers, "
+              << local_files.size() << " loose files hashed locally.\n";
+
+    CollisionMap collisions = aggregator.finish();
+    HardlinkMap hardlinks; // Hardlink identity is per-node; not tracked here
+
+    if (!output_path.empty()) {
+        write_collisions_jsonl(collisions, hardlinks, output_path);
+    }
+    if (show_collisions) {
+        display_collisions(collisions, hardlinks);
+    } else {
+        std::cout << "Duplicates were found for " << collisions.size() << " individual files\n\n";
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// Logic: Watch Mode (inotify daemon)
+// ---------------------------------------------------------
+// --watch turns the tool into a resident daemon: one initial scan seeds an
+// in-memory hash_to_files index (full digests for every file, cache-
+// assisted), then inotify events drive incremental re-hashing of only the
+// files that changed. Duplicate queries are answered from memory on stdin:
+//   dupes <path>   print the files sharing <path>'s content
+//   groups         print all current collision groups
+//   quit           exit
+// This replaces the nightly full re-scan with a sub-second query against an
+// index that is never more than one event behind the filesystem.
+#ifdef __linux__
+
+// Resident index kept in sync by the event loop. Singleton digests are kept
+// too: a file only becomes a duplicate when its future twin arrives.
+class WatchIndex {
+    std::unordered_map<Digest, std::vector<fs::path>, DigestHasher> hash_to_files;
+    std::unordered_map<std::string, Digest> file_to_hash;
+
+public:
+    // Insert or refresh one file. Returns the number of other files now
+    // sharing the digest, so the caller can announce new duplicates.
+    std::size_t update(const fs::path& path, const Digest& hash) {
+        remove(path);
+        file_to_hash[path.string()] = hash;
+        std::vector<fs::path>& group = hash_to_files[hash];
+        group.push_back(path);
+        return group.size() - 1;
+    }
+
+    void remove(const fs::path& path) {
+        auto it = file_to_hash.find(path.string());
+        if (it == file_to_hash.end()) return;
+        auto group_it = hash_to_files.find(it->second);
+        if (group_it != hash_to_files.end()) {
+            auto& group = group_it->second;
+            group.erase(std::remove(group.begin(), group.end(), path), group.end());
+            if (group.empty()) hash_to_files.erase(group_it);
+        }
+        file_to_hash.erase(it);
+    }
+
+    // Purge every indexed file underneath a directory that was deleted or
+    // moved away: inotify reports only the directory itself, not the files
+    // inside it, so the index has to do the recursion.
+    void remove_subtree(const fs::path& prefix) {
+        std::string want = prefix.string() + '/';
+        std::vector<fs::path> victims;
+        for (const auto& [path, hash] : file_to_hash) {
+            if (path.compare(0, want.size(), want) == 0) victims.emplace_back(path);
+        }
+        for (const auto& p : victims) remove(p);
+    }
+
+    void query(const fs::path& path) const {
+        auto it = file_to_hash.find(path.string());
+        if (it == file_to_hash.end()) {
+            std::cout << "not indexed: " << path.string() << "\n";
+            return;
+        }
+        const auto& group = hash_to_files.at(it->second);
+        if (group.size() < 2) {
+            std::cout << "no duplicates: " << path.string() << "\n";
+            return;
+        }
+        std::cout << "duplicates of " << path.string() << " (" << it->second.hex() << "):\n";
+        for (const auto& p : group) {
+            if (p != path) std::cout << "  " << p.string() << "\n";
+        }
+    }
+
+    void print_groups() const {
+        std::size_t shown = 0;
+        for (const auto& [hash, group] : hash_to_files) {
+            if (group.size() < 2) continue;
+            std::cout << "group " << hash.hex() << ":\n";
+            for (const auto& p : group) std::cout << "  " << p.string() << "\n";
+            ++shown;
+        }
+        if (!shown) std::cout << "no duplicate groups\n";
+    }
+};
+
+int run_watch(const std::vector<std::string>& dirs) {
+    std::cout << "Building initial index...\n";
+    HashCache cache;
+    cache.load(HASH_CACHE_FILE);
+
+    // Full digests for every file (unlike the batch pipeline there is no
+    // size pre-filter: the twin of a parked file may arrive hours later).
+    std::vector<FileEntry> entries = get_file_paths(dirs);
+    WatchIndex index;
+    std::vector<fs::path> to_hash;
+    std::size_t cached_count = 0;
+    for (auto& e : entries) {
+        fs::path p = e.full_path();
+        struct stat st;
+        if (::stat(p.c_str(), &st) != 0) continue;
+        Digest cached = cache.lookup(p, static_cast<std::uintmax_t>(st.st_size),
+                                     HashCache::mtime_of(st));
+        if (cached.ok) {
+            ++cached_count;
+            index.update(p, cached);
+        } else {
+            to_hash.push_back(std::move(p));
+        }
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+
+    g_active_cache = &cache;
+    std::vector<FileResult> hashed = process_files_parallel(to_hash, HashMode::Fast);
+    g_active_cache = nullptr;
+    for (auto& res : hashed) {
+        index.update(res.path, res.hash);
+    }
+    cache.save(HASH_CACHE_FILE);
+    std::cout << "Indexed " << cached_count + hashed.size() << " files ("
+              << cached_count << " from cache).\n";
+
+    int ifd = ::inotify_init();
+    if (ifd < 0) {
+        std::cerr << "Error: inotify_init: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    std::unordered_map<int, fs::path> watch_dirs;
+    constexpr std::uint32_t WATCH_MASK =
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+    auto add_watch = [&](const fs::path& dir) {
+        int wd = ::inotify_add_watch(ifd, dir.c_str(), WATCH_MASK);
+        if (wd >= 0) watch_dirs[wd] = dir;
+        else std::cerr << "Warning: cannot watch " << dir.string()
+                       << " (" << std::strerror(errno) << ")\n";
+    };
+
+    // Watch every directory in the tree, honoring the same pruning the
+    // traversal applies.
+    std::vector<fs::path> pending;
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        if (fs::exists(dir, ec) && fs::is_directory(dir, ec)) {
+            pending.push_back(fs::absolute(dir));
+        }
+    }
+    while (!pending.empty()) {
+        fs::path current = std::move(pending.back());
+        pending.pop_back();
+        add_watch(current);
+        std::error_code ec;
+        for (fs::directory_iterator it(current, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code ec_type;
+            if (it->is_directory(ec_type) && !it->is_symlink(ec_type) &&
+                g_filter.allows_dir(it->path().filename().string())) {
+                pending.push_back(it->path());
+            }
+        }
+    }
+    std::cout << "Watching " << watch_dirs.size()
+              << " directories. Commands: dupes <path>, groups, quit\n" << std::flush;
+
+    // Re-hash one changed file and fold it into the index.
+    auto reindex_file = [&](const fs::path& p) {
+        struct stat st;
+        if (::stat(p.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return;
+        if (!g_filter.allows_file(p.filename().string(),
+                                  static_cast<std::uintmax_t>(st.st_size))) return;
+        Digest h = hash_file(p);
+        if (!h.ok) return;
+        cache.store(p, static_cast<std::uintmax_t>(st.st_size), HashCache::mtime_of(st), h);
+        std::size_t twins = index.update(p, h);
+        if (twins > 0) {
+            std::cout << "duplicate detected: " << p.string()
+                      << " (" << twins << " existing cop" << (twins == 1 ? "y" : "ies") << ")\n";
+        }
+    };
+
+    // Watch and index a subtree that appeared after startup (mkdir -p, or a
+    // whole tree moved in): one level is not enough, the startup sweep's
+    // recursion has to happen here too.
+    auto sweep_new_tree = [&](const fs::path& root) {
+        std::vector<fs::path> stack{root};
+        while (!stack.empty()) {
+            fs::path current = std::move(stack.back());
+            stack.pop_back();
+            add_watch(current);
+            std::error_code ec;
+            for (fs::directory_iterator it(current, ec), end; !ec && it != end;
+                 it.increment(ec)) {
+                std::error_code ec_type;
+                if (it->is_directory(ec_type) && !it->is_symlink(ec_type)) {
+                    if (g_filter.allows_dir(it->path().filename().string())) {
+                        stack.push_back(it->path());
+                    }
+                } else if (it->is_regular_file(ec_type)) {
+                    reindex_file(it->path());
+                }
+            }
+        }
+    };
+
+    char event_buf[4096] __attribute__((aligned(alignof(inotify_event))));
+    while (true) {
+        pollfd fds[2] = {{ifd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t n = ::read(ifd, event_buf, sizeof(event_buf));
+            for (ssize_t off = 0; off < n;) {
+                auto* ev = reinterpret_cast<inotify_event*>(event_buf + off);
+                off += sizeof(inotify_event) + ev->len;
+                auto dir_it = watch_dirs.find(ev->wd);
+                if (dir_it == watch_dirs.end() || ev->len == 0) continue;
+                fs::path full = dir_it->second / ev->name;
+
+                if (ev->mask & IN_ISDIR) {
+                    // A new tree starts being watched immediately; the sweep
+                    // also indexes any files that raced in before the watch.
+                    if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                        g_filter.allows_dir(ev->name)) {
+                        sweep_new_tree(full);
+                    } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        // The directory is gone from this spot: purge its
+                        // files from the index and drop the watches recorded
+                        // under the now-stale path.
+                        index.remove_subtree(full);
+                        std::string want = full.string() + '/';
+                        for (auto wit = watch_dirs.begin(); wit != watch_dirs.end();) {
+                            const std::string d = wit->second.string();
+                            if (d == full.string() ||
+                                d.compare(0, want.size(), want) == 0) {
+                                ::inotify_rm_watch(ifd, wit->first);
+                                wit = watch_dirs.erase(wit);
+                            } else {
+                                ++wit;
+                            }
+                        }
+                    }
+                } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    reindex_file(full);
+                } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    index.remove(full);
+                }
+            }
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            std::string line;
+            if (!std::getline(std::cin, line)) break;
+            if (line == "quit") break;
+            if (line == "groups") {
+                index.print_groups();
+            } else if (line.rfind("dupes ", 0) == 0) {
+                index.query(fs::absolute(line.substr(6)));
+            } else if (!line.empty()) {
+                std::cout << "commands: dupes <path>, groups, quit\n";
+            }
+            std::cout << std::flush;
+        }
+    }
+
+    cache.save(HASH_CACHE_FILE);
+    ::close(ifd);
+    return 0;
+}
+
+#else // !__linux__
+
+int run_watch(const std::vector<std::string>&) {
+    std::cerr << "Error: --watch requires Linux inotify\n";
+    return 1;
+}
+
+#endif
+
+// ---------------------------------------------------------
+// Logic: Benchmark Harness
+// ---------------------------------------------------------
+// --bench generates a synthetic corpus (like dupgen.py, but in-process and
+// fast enough for CI-sized runs), then exercises the traversal, prefix,
+// full-hash and aggregation phases separately and reports per-phase
+// throughput. This gives a repeatable yardstick for kernel, filesystem or
+// code changes without touching production data.
+
+// Cheap deterministic byte generator (xorshift64) so corpus generation is
+// reproducible and not bottlenecked on a real RNG.
+struct BenchRng {
+    std::uint64_t state;
+    explicit BenchRng(std::uint64_t seed) : state(seed ? seed : 0x9e3779b97f4a7c15ULL) {}
+    std::uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+int run_benchmark(std::size_t num_files, std::size_t avg_size_kb, unsigned dup_percent) {
+    fs::path root = fs::temp_directory_path() /
+                    ("find_dupes_bench_" + std::to_string(::getpid()));
+    std::error_code ec;
+    fs::remove_all(root, ec);
+
+    std::cout << "Generating corpus: " << num_files << " files, ~" << avg_size_kb
+              << "KB each, " << dup_percent << "% duplicates under " << root.string() << "\n";
+
+    // Spread files over ~sqrt(n) directories so traversal sees a real tree,
+    // not one flat directory.
+    std::size_t num_dirs = 1;
+    while (num_dirs * num_dirs < num_files) ++num_dirs;
+
+    BenchRng rng(42);
+    std::vector<char> content;
+    std::uint64_t corpus_bytes = 0;
+    {
+        Timer phase("bench: generation", /*record_phase=*/true);
+        for (std::size_t i = 0; i < num_files; ++i) {
+            fs::path dir = root / ("d" + std::to_string(i % num_dirs));
+            fs::create_directories(dir, ec);
+
+            // A duplicate reuses the previous file's content; a unique file
+            // gets fresh bytes with a size spread of 0.5x-1.5x the average.
+            bool duplicate = !content.empty() && (rng.next() % 100) < dup_percent;
+            if (!duplicate) {
+                std::size_t size = avg_size_kb * 512 + rng.next() % (avg_size_kb * 1024);
+                content.resize(size);
+                for (std::size_t off = 0; off < size; off += 8) {
+                    std::uint64_t v = rng.next();
+                    std::memcpy(content.data() + off, &v, std::min<std::size_t>(8, size - off));
+                }
+            }
+
+            std::ofstream out(dir / ("f" + std::to_string(i)), std::ios::binary);
+            out.write(content.data(), content.size());
+            corpus_bytes += content.size();
+        }
+    }
+
+    auto phase_report = [](const char* name, double seconds, std::uint64_t items,
+                           const char* unit, std::uint64_t bytes) {
+        std::cout << "  " << std::left << std::setw(16) << name
+                  << std::fixed << std::setprecision(3) << seconds << " s, "
+                  << std::setprecision(0) << (seconds > 0 ? items / seconds : 0)
+                  << " " << unit << "/s";
+        if (bytes) {
+            std::cout << ", " << std::setprecision(1)
+                      << (seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0) << " MB/s";
+        }
+        std::cout << std::defaultfloat << "\n";
+    };
+
+    std::cout << "\nBenchmark results:\n";
+
+    auto now = [] { return std::chrono::steady_clock::now(); };
+    auto seconds_since = [&](std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double>(now() - t0).count();
+    };
+
+    auto t0 = now();
+    std::vector<FileEntry> entries = get_file_paths({root.string()});
+    phase_report("traversal", seconds_since(t0), entries.size(), "files", 0);
+
+    std::vector<fs::path> paths;
+    paths.reserve(entries.size());
+    for (auto& e : entries) paths.push_back(e.full_path());
+
+    std::uint64_t bytes_before = g_stats.bytes_hashed.load();
+    t0 = now();
+    std::vector<FileResult> prefix_results = process_files_parallel(paths, HashMode::Prefix);
+    phase_report("prefix hash", seconds_since(t0), paths.size(), "files",
+                 g_stats.bytes_hashed.load() - bytes_before);
+
+    bytes_before = g_stats.bytes_hashed.load();
+    t0 = now();
+    std::vector<FileResult> full_results = process_files_parallel(paths, HashMode::Fast);
+    phase_report("full hash", seconds_since(t0), paths.size(), "files",
+                 g_stats.bytes_hashed.load() - bytes_before);
+
+    t0 = now();
+    CollisionMap groups;
+    groups.reserve(full_results.size());
+    for (auto& res : full_results) {
+        groups[res.hash].push_back(std::move(res.path));
+    }
+    std::size_t dup_groups = 0;
+    for (const auto& [hash, group] : groups) {
+        if (group.size() > 1) ++dup_groups;
+    }
+    phase_report("aggregation", seconds_since(t0), full_results.size(), "results", 0);
+
+    std::cout << "\nCorpus: " << paths.size() << " files, "
+              << std::fixed << std::setprecision(1) << corpus_bytes / (1024.0 * 1024.0)
+              << std::defaultfloat << " MB, "
+              << dup_groups << " duplicate groups found\n";
+
+    fs::remove_all(root, ec);
+    return 0;
+}
+
+// Parses a plain non-negative decimal flag argument. A CLI typo should be a
+// one-line error like parse_size gives, not an uncaught std::invalid_argument
+// out of std::stoul aborting the process.
+std::uintmax_t parse_count(const std::string& s, const char* flag) {
+    char* end = nullptr;
+    errno = 0;
+    std::uintmax_t value = std::strtoull(s.c_str(), &end, 10);
+    if (s.empty() || errno != 0 || end == s.c_str() || *end != '\0') {
+        std::cerr << "Error: " << flag << " expects a number, got '" << s << "'\n";
+        std::exit(1);
+    }
+    return value;
+}
+
+// Parses sizes like "4096", "512K", "1M", "2G" (binary multiples).
+std::uintmax_t parse_size(const std::string& s) {
+    char* end = nullptr;
+    std::uintmax_t value = std::strtoull(s.c_str(), &end, 10);
+    std::uintmax_t mult = 1;
+    if (end && *end) {
+        switch (*end) {
+            case 'k': case 'K': mult = 1024ULL; break;
+            case 'm': case 'M': mult = 1024ULL * 1024; break;
+            case 'g': case 'G': mult = 1024ULL * 1024 * 1024; break;
+            case 't': case 'T': mult = 1024ULL * 1024 * 1024 * 1024; break;
+            default:
+                std::cerr << "Error: unrecognized size suffix in '" << s << "'\n";
+                std::exit(1);
+        }
+    }
+    return value * mult;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <directory>... [--show-duplicates] [--delete] [--link] [--stream] [--uring]\n"
+                  << "           [--output <file>] [--max-mem <MB>] [--min-size <N[KMGT]>] [--max-size <N[KMGT]>]\n"
+                  << "           [--exclude <glob>]... [--ext <ext,ext,...>] [--digest md5|sha1|sha256|sha512]\n"
+                  << "           [--workers <host:port,...>] [--threads <n>] [--cpuset <list>] [--chunk-dupes <pct>]\n"
+                  << "       " << argv[0] << " --worker [--port <n>]\n"
+                  << "       " << argv[0] << " --bench [num_files [avg_size_kb [dup_percent]]]\n";
+        return 1;
+    }
+
+    if (std::string(argv[1]) == "--bench") {
+        std::size_t num_files = argc > 2 ? parse_count(argv[2], "--bench num_files") : 20000;
+        std::size_t avg_size_kb = argc > 3 ? parse_count(argv[3], "--bench avg_size_kb") : 16;
+        unsigned dup_percent = argc > 4
+            ? static_cast<unsigned>(parse_count(argv[4], "--bench dup_percent")) : 25;
+        return run_benchmark(num_files, avg_size_kb, dup_percent);
+    }
+
+    // Every non-flag argument is a scan root; duplicates are found across
+    // all of them in a single pass.
+    std::vector<std::string> directories;
+    bool show_duplicates = false;
     bool delete_flag = false;
+    bool link_flag = false;
+    bool stream = false;
+    bool worker_mode = false;
+    bool watch_mode = false;
+    int worker_port = WORKER_DEFAULT_PORT;
+    std::vector<std::string> worker_specs;
+    std::string output_path;
 
-    for (int i = 2; i < argc; ++i) {
+    for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--show-duplicates") show_duplicates = true;
         else if (arg == "--delete") delete_flag = true;
+        else if (arg == "--link") link_flag = true;
+        else if (arg == "--stream") stream = true;
+        else if (arg == "--uring") {
+#ifdef FIND_DUPES_HAVE_URING
+            use_uring = true;
+#else
+            std::cerr << "Warning: built without io_uring support, using synchronous reads\n";
+#endif
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --output requires a file argument\n";
+                return 1;
+            }
+            output_path = argv[++i];
+        }
+        else if (arg == "--max-mem") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --max-mem requires a size in MB\n";
+                return 1;
+            }
+            g_max_mem_bytes = parse_count(argv[++i], "--max-mem") * (1024ULL * 1024ULL);
+        }
+        else if (arg == "--chunk-dupes") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --chunk-dupes requires a minimum shared-chunk percentage\n";
+                return 1;
+            }
+            g_chunk_share_percent = static_cast<unsigned>(parse_count(argv[++i], "--chunk-dupes"));
+            if (g_chunk_share_percent == 0 || g_chunk_share_percent > 100) {
+                std::cerr << "Error: --chunk-dupes percentage must be between 1 and 100\n";
+                return 1;
+            }
+        }
+        else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --threads requires a count\n";
+                return 1;
+            }
+            g_thread_override = static_cast<unsigned int>(parse_count(argv[++i], "--threads"));
+        }
+        else if (arg == "--cpuset") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --cpuset requires a CPU list (e.g. 0-7,16-23)\n";
+                return 1;
+            }
+            std::stringstream ranges(argv[++i]);
+            std::string range;
+            while (std::getline(ranges, range, ',')) {
+                if (range.empty()) continue;
+                auto dash = range.find('-');
+                int lo = static_cast<int>(parse_count(range.substr(0, dash), "--cpuset"));
+                int hi = dash == std::string::npos
+                    ? lo : static_cast<int>(parse_count(range.substr(dash + 1), "--cpuset"));
+                for (int cpu = lo; cpu <= hi; ++cpu) g_cpuset.push_back(cpu);
+            }
+#ifndef __linux__
+            std::cerr << "Warning: --cpuset pinning is only supported on Linux; "
+                      << "using it for pool sizing only\n";
+#endif
+        }
+        else if (arg == "--worker") worker_mode = true;
+        else if (arg == "--watch") watch_mode = true;
+        else if (arg == "--port") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --port requires a port number\n";
+                return 1;
+            }
+            std::uintmax_t port = parse_count(argv[++i], "--port");
+            if (port == 0 || port > 65535) {
+                std::cerr << "Error: --port must be between 1 and 65535\n";
+                return 1;
+            }
+            worker_port = static_cast<int>(port);
+        }
+        else if (arg == "--workers") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --workers requires a comma-separated host:port list\n";
+                return 1;
+            }
+            std::stringstream specs(argv[++i]);
+            std::string spec;
+            while (std::getline(specs, spec, ',')) {
+                if (!spec.empty()) worker_specs.push_back(spec);
+            }
+        }
+        else if (arg == "--digest") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --digest requires an algorithm (md5, sha1, sha256, sha512)\n";
+                return 1;
+            }
+            std::string algo = argv[++i];
+            if (algo == "md5") g_crypto_md = EVP_md5();
+            else if (algo == "sha1") g_crypto_md = EVP_sha1();
+            else if (algo == "sha256") g_crypto_md = EVP_sha256();
+            else if (algo == "sha512") g_crypto_md = EVP_sha512();
+            else {
+                std::cerr << "Error: unsupported digest '" << algo << "' (md5, sha1, sha256, sha512)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--min-size") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --min-size requires a size (e.g. 1M)\n";
+                return 1;
+            }
+            g_filter.min_size = parse_size(argv[++i]);
+        }
+        else if (arg == "--max-size") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --max-size requires a size (e.g. 1G)\n";
+                return 1;
+            }
+            g_filter.max_size = parse_size(argv[++i]);
+        }
+        else if (arg == "--exclude") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --exclude requires a glob pattern\n";
+                return 1;
+            }
+            g_filter.exclude_globs.push_back(argv[++i]);
+        }
+        else if (arg == "--ext") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --ext requires a comma-separated extension list\n";
+                return 1;
+            }
+            std::stringstream exts(argv[++i]);
+            std::string ext;
+            while (std::getline(exts, ext, ',')) {
+                if (ext.empty()) continue;
+                if (ext[0] != '.') ext.insert(ext.begin(), '.');
+                g_filter.extensions.push_back(ext);
+            }
+        }
+        else directories.push_back(arg);
+    }
+
+    if (worker_mode) {
+        return run_worker(worker_port);
+    }
+
+    if (directories.empty()) {
+        std::cerr << "Error: no scan directory given\n";
+        return 1;
+    }
+
+    if (watch_mode) {
+        if (delete_flag || link_flag || !worker_specs.empty()) {
+            std::cerr << "Error: --watch cannot be combined with --delete, --link or --workers\n";
+            return 1;
+        }
+        return run_watch(directories);
+    }
+
+    if (!worker_specs.empty()) {
+        if (delete_flag || link_flag) {
+            std::cerr << "Error: --delete/--link are not supported in distributed mode\n";
+            return 1;
+        }
+        return run_coordinator(directories, worker_specs, show_duplicates, output_path);
+    }
+
+    if (delete_flag && link_flag) {
+        std::cerr << "Error: --delete and --link are mutually exclusive\n";
+        return 1;
     }
 
-    clean_up(directory, show_duplicates, delete_flag);
+    clean_up(directories, show_duplicates, delete_flag, stream, link_flag, output_path);
 
     return 0;
 }